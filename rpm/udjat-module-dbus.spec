@@ -97,6 +97,7 @@ make all
 %{_includedir}/udjat/tools/*.h
 %{_includedir}/udjat/tools/dbus/*.h
 %{_includedir}/udjat/alert/*.h
+%{_includedir}/udjat/agent/*.h
 %{_libdir}/*.so
 %exclude %{_libdir}/*.a
 %{_libdir}/pkgconfig/*.pc
@@ -27,6 +27,16 @@
  #include <udjat/defs.h>
  #include <dbus/dbus.h>
  #include <udjat/tools/dbus/connection.h>
+ #include <udjat/tools/mainloop.h>
+ #include <udjat/tools/handler.h>
+ #include <atomic>
+ #include <mutex>
+ #include <thread>
+ #include <deque>
+ #include <vector>
+ #include <unordered_map>
+ #include <chrono>
+ #include <functional>
 
  using namespace std;
  using namespace Udjat;
@@ -44,3 +54,115 @@
 	UDJAT_PRIVATE void toggle_timeout(DBusTimeout *t, Udjat::Abstract::DBus::Connection *connection);
 
  }
+
+ /// @brief Wakes the main loop to dispatch the messages left by the budget.
+ class UDJAT_PRIVATE Udjat::Abstract::DBus::Connection::Dispatcher : public Udjat::MainLoop::Handler {
+ private:
+
+	Abstract::DBus::Connection &connection;
+
+	/// @brief The eventfd signaling pending messages.
+	int efd;
+
+	/// @brief True if the eventfd was signaled and not handled.
+	std::atomic<bool> pending{false};
+
+	/// @brief Methods posted to the main loop.
+	std::mutex guard;
+	std::deque<std::function<void()>> tasks;
+
+ protected:
+	void handle_event(const Event events) override;
+
+ public:
+	Dispatcher(Abstract::DBus::Connection &connection);
+	~Dispatcher();
+
+	/// @brief Request a dispatch on the next main loop wakeup, can be called from any thread.
+	void wakeup() noexcept;
+
+	/// @brief Run method on the next main loop wakeup, can be called from any thread.
+	void post(const std::function<void()> &method);
+
+ };
+
+ /// @brief Dedicated epoll driven I/O and dispatch thread.
+ class UDJAT_PRIVATE Udjat::Abstract::DBus::Connection::Service {
+ private:
+
+	Abstract::DBus::Connection &connection;
+
+	int epfd;		///< @brief The epoll descriptor.
+	int efd;		///< @brief The eventfd for wakeup and stop.
+
+	std::atomic<bool> enabled{true};
+	std::thread thread;
+
+	/// @brief Detached by stop_thread() from the thread itself, it will delete the service on exit.
+	bool detached = false;
+
+	std::mutex guard;
+
+	/// @brief Watches by file descriptor, epoll does not accept the same descriptor twice.
+	struct Watches {
+		std::vector<DBusWatch *> watches;
+		bool registered = false;
+		uint32_t events = 0;
+	};
+	std::unordered_map<int,Watches> fds;
+
+	/// @brief Timeouts and their deadlines.
+	struct Timeout {
+		DBusTimeout *timeout;
+		std::chrono::steady_clock::time_point deadline;
+		uint64_t id;	///< @brief Unique id, libdbus can reuse the address of a removed timeout.
+	};
+	std::vector<Timeout> timeouts;
+
+	/// @brief Id of the last added timeout.
+	uint64_t added = 0;
+
+	/// @brief Reusable buffers for the thread loop.
+	std::vector<DBusWatch *> handling;
+	std::vector<std::pair<DBusTimeout *,uint64_t>> expired;
+
+	/// @brief Update epoll events for the descriptor, must be called with the guard locked.
+	void update(int fd);
+
+	/// @brief Handle events on the descriptor.
+	void handle(int fd, uint32_t events);
+
+	/// @brief Get time to the next timeout in milliseconds, -1 if none.
+	int next_timeout();
+
+	/// @brief Handle expired timeouts.
+	void expire();
+
+	void run();
+
+ public:
+	Service(Abstract::DBus::Connection &connection);
+	~Service();
+
+	void start();
+	void stop();
+
+	/// @brief Stop without waiting, must be called from the service thread.
+	void detach();
+
+	inline bool current() const noexcept {
+		return std::this_thread::get_id() == thread.get_id();
+	}
+
+	/// @brief Wake the thread, can be called from any thread.
+	void wakeup() noexcept;
+
+	static dbus_bool_t add_watch(DBusWatch *w, Service *service);
+	static void remove_watch(DBusWatch *w, Service *service);
+	static void toggle_watch(DBusWatch *w, Service *service);
+
+	static dbus_bool_t add_timeout(DBusTimeout *t, Service *service);
+	static void remove_timeout(DBusTimeout *t, Service *service);
+	static void toggle_timeout(DBusTimeout *t, Service *service);
+
+ };
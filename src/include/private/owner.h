@@ -0,0 +1,74 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Declare the owner tracker of well-known bus names.
+  */
+
+ #pragma once
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <dbus/dbus.h>
+ #include <udjat/tools/dbus/member.h>
+ #include <string>
+ #include <mutex>
+
+ namespace Udjat {
+
+	namespace DBus {
+
+		/// @brief Unique name owning a well-known bus name.
+		/// @details Updated by the GetNameOwner reply and the NameOwnerChanged signals, the newer one wins.
+		class UDJAT_PRIVATE Member::Owner {
+		private:
+
+			mutable std::mutex guard;
+
+			/// @brief The unique name, empty if the name has no owner.
+			std::string unique;
+
+			/// @brief False until the bus daemon answers.
+			bool resolved = false;
+
+			/// @brief Serial of the last update, the bus daemon numbers its messages in order.
+			dbus_uint32_t serial = 0;
+
+		public:
+
+			/// @brief The well-known name.
+			const std::string name;
+
+			Owner(const char *n) : name{n} {
+			}
+
+			/// @brief Update the owner, older messages are ignored.
+			/// @param unique The new owner, empty if the name was released.
+			/// @param serial Serial of the bus daemon message, 0 if unknown (an error reply).
+			void set(const char *unique, dbus_uint32_t serial) noexcept;
+
+			/// @brief Check the sender of a signal.
+			/// @return true if the sender owns the name or the owner is not known yet.
+			bool is(const char *sender) const noexcept;
+
+		};
+
+	}
+
+ }
@@ -0,0 +1,135 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+ /**
+  * @brief Declare the queue for signal handlers running outside the connection thread.
+  */
+
+ #pragma once
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <dbus/dbus.h>
+ #include <udjat/tools/dbus/member.h>
+ #include <udjat/tools/mainloop.h>
+ #include <udjat/tools/timer.h>
+ #include <mutex>
+ #include <condition_variable>
+ #include <thread>
+ #include <deque>
+ #include <memory>
+ #include <string>
+ #include <atomic>
+
+ namespace Udjat {
+
+	namespace DBus {
+
+		/// @brief Bounded signal queue, the handler receives the signals one at a time in arrival order.
+		/// @details Applies the coalescing policy and the time window from the dispatch settings.
+		class UDJAT_PRIVATE Member::Queue : public std::enable_shared_from_this<Member::Queue> {
+		public:
+
+			/// @brief Reply to a message dropped without handling.
+			using Reject = std::function<void(DBusMessage *message, const char *name, const char *text)>;
+
+		private:
+
+			std::mutex guard;
+			std::condition_variable condition;
+
+			/// @brief Pending signals, with a reference held.
+			std::deque<DBusMessage *> messages;
+
+			/// @brief Member name, for logging.
+			std::string name;
+
+			/// @brief Execution settings.
+			Dispatch dispatch;
+
+			std::function<void(Message & message)> callback;
+
+			/// @brief Reply to the dropped messages, empty for signals.
+			/// @details With it the queue never waits for room, the new messages are rejected.
+			Reject reject;
+
+			/// @brief False after stop, pending and new signals are discarded.
+			bool enabled = true;
+
+			/// @brief True while a thread pool worker is handling the queue.
+			bool running = false;
+
+			/// @brief True while the time window is open, the pending signals are held.
+			bool held = false;
+
+			/// @brief Timer closing the time window.
+			class Timer : public MainLoop::Timer {
+			private:
+				Queue &queue;
+
+			protected:
+				void on_timer() override;
+
+			public:
+				Timer(Queue &q) : queue{q} {
+				}
+
+			} timer{*this};
+
+			/// @brief Handle one signal.
+			void call(DBusMessage *message) noexcept;
+
+			/// @brief Handle pending signals until the queue is empty or held.
+			void run();
+
+			/// @brief Coalesce the signal with the pending ones, must be called with the guard locked.
+			/// @return true if the signal was merged into a pending one.
+			bool coalesce(DBusMessage *message);
+
+			/// @brief Start delivering the pending signals, must be called with the guard locked.
+			void release(std::unique_lock<std::mutex> &lock);
+
+		public:
+			Queue(const char *name, const Dispatch &dispatch, const std::function<void(Message & message)> &callback);
+
+			/// @brief Build a queue for method calls.
+			/// @param reject Reply to the calls dropped when the queue is full or stopped.
+			Queue(const char *name, const Dispatch &dispatch, const std::function<void(Message & message)> &callback, const Reject &reject);
+			~Queue();
+
+			/// @brief Start the dedicated thread for serial dispatch.
+			void start();
+
+			/// @brief Enqueue signal, wait for room if the queue is full.
+			void push(DBusMessage *message);
+
+			/// @brief Set the flag of the dispatching thread, after it's cleared the pushes from that thread stop waiting for room.
+			/// @param enabled The flag, nullptr to unbind.
+			static void bind(const std::atomic<bool> *enabled) noexcept;
+
+			/// @brief Discard pending messages, rejecting the method calls, and release the worker.
+			/// @details Does not wait for a handler already running, it can be called from the handler itself.
+			void stop() noexcept;
+
+		};
+
+	}
+
+ }
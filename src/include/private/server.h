@@ -0,0 +1,119 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Declare the exported object server.
+  */
+
+ #pragma once
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <dbus/dbus.h>
+ #include <udjat/tools/dbus/connection.h>
+ #include <udjat/tools/dbus/request.h>
+ #include <string>
+ #include <string_view>
+ #include <vector>
+ #include <unordered_map>
+ #include <memory>
+
+ /// @brief Exported methods, in a prefix tree of the object path segments.
+ /// @details Must be used with the connection guard locked; shared for lookup, exclusive for changes.
+ class UDJAT_PRIVATE Udjat::Abstract::DBus::Connection::ObjectServer {
+ public:
+
+	/// @brief Exported method.
+	class Method {
+	private:
+		/// @brief Queue for handlers running outside the connection thread, empty on inline dispatch.
+		std::shared_ptr<Udjat::DBus::Member::Queue> queue;
+
+	public:
+		std::string interface;
+		std::string member;
+		Udjat::DBus::Method handler;
+
+		/// @brief Precomputed hash of interface and member names.
+		size_t hash;
+
+		Method(const char *interface, const char *member, const Udjat::DBus::Method &handler, std::shared_ptr<Udjat::DBus::Member::Queue> queue);
+		~Method();
+
+		/// @brief Handle the call, the handler gets a request holding a reference to the message.
+		void call(DBusConnection *conn, DBusMessage *message) const;
+
+	};
+
+ private:
+
+	/// @brief Path segment.
+	struct Node {
+
+		std::string name;
+
+		/// @brief Child segments, sorted by name.
+		std::vector<std::unique_ptr<Node>> children;
+
+		/// @brief Methods, indexed by the combined hash of interface and member names.
+		std::unordered_map<size_t,std::vector<std::shared_ptr<const Method>>> methods;
+
+		Node(std::string_view n = std::string_view{}) : name{n} {
+		}
+
+		/// @brief Find child segment.
+		/// @param insert Insert the segment if not found.
+		Node * child(std::string_view name, bool insert = false);
+
+		inline bool empty() const noexcept {
+			return children.empty() && methods.empty();
+		}
+
+	};
+
+	Node root;
+
+	/// @brief Find path node.
+	/// @param insert Insert the missing segments.
+	Node * find(const char *path, bool insert = false);
+
+	/// @brief Remove the methods from the node and its children.
+	/// @return Number of methods removed.
+	static size_t remove(Node &node, const char *path, const char *interface);
+
+ public:
+
+	/// @brief Add method to object path, replacing an older handler for the same interface and member.
+	void insert(const char *path, std::shared_ptr<const Method> method);
+
+	/// @brief Remove methods from object path.
+	/// @param interface The interface name, nullptr for all interfaces.
+	/// @return Number of methods removed.
+	size_t remove(const char *path, const char *interface);
+
+	/// @brief Find method for the call.
+	/// @param interface The interface name, nullptr matches any interface.
+	/// @return The method, empty if not exported.
+	std::shared_ptr<const Method> find(const char *path, const char *interface, const char *member) const noexcept;
+
+	inline bool empty() const noexcept {
+		return root.empty();
+	}
+
+ };
@@ -0,0 +1,91 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Declare d-bus agents.
+  */
+
+ #pragma once
+
+ #include <udjat/defs.h>
+ #include <udjat/agent/abstract.h>
+ #include <udjat/tools/dbus/connection.h>
+ #include <udjat/tools/dbus/value.h>
+ #include <string>
+ #include <memory>
+ #include <mutex>
+
+ namespace Udjat {
+
+	namespace DBus {
+
+		/// @brief Agent mirroring a remote d-bus property.
+		/// @details Gets the property once on start, then updates only from the PropertiesChanged signals
+		/// of the remote object; there's no polling.
+		class UDJAT_API Agent : public Udjat::Abstract::Agent {
+		private:
+
+			/// @brief Bus connection.
+			std::shared_ptr<Abstract::DBus::Connection> connection;
+
+			std::string destination;	///< @brief Bus name of the remote object.
+			std::string path;			///< @brief Path of the remote object.
+			std::string iface;			///< @brief Interface of the property.
+			std::string property;		///< @brief Name of the property.
+
+			/// @brief How the PropertiesChanged signal handler is executed.
+			Udjat::DBus::Member::Dispatch dispatch;
+
+			/// @brief PropertiesChanged subscription, nullptr when stopped.
+			Udjat::DBus::Member *member = nullptr;
+
+			/// @brief Link from the signal and the reply handlers, released when the agent stops.
+			struct Link;
+			std::shared_ptr<Link> link;
+
+			/// @brief Guard for the value.
+			mutable std::mutex guard;
+
+			/// @brief The property value.
+			Udjat::DBus::Value value;
+
+			/// @brief Get the property value from the remote object.
+			void fetch();
+
+			/// @brief Update property value.
+			void set(const Udjat::DBus::Value &value);
+
+		public:
+			Agent(const XML::Node &node);
+			virtual ~Agent();
+
+			void start() override;
+			void stop() override;
+
+			/// @brief The value is updated by signals, nothing to refresh.
+			bool refresh() override;
+
+			std::string to_string() const noexcept override;
+			Udjat::Value & get(Udjat::Value &value) const override;
+
+		};
+
+	}
+
+ }
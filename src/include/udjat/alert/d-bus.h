@@ -63,6 +63,10 @@
 			/// @brief D-Bus message arguments.
 			std::vector<Argument> arguments;
 
+			/// @brief Signal template for the last expanded names, shared with the activations.
+			struct Prototype;
+			std::shared_ptr<Prototype> prototype;
+
 		public:
 			Alert(const Abstract::Object &parent, const pugi::xml_node &node);
 			virtual ~Alert();
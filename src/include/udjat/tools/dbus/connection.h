@@ -28,10 +28,16 @@
  #include <udjat/tools/dbus/defs.h>
  #include <udjat/tools/dbus/interface.h>
  #include <udjat/tools/dbus/member.h>
+ #include <udjat/tools/dbus/request.h>
  #include <string>
  #include <mutex>
+ #include <shared_mutex>
  #include <thread>
  #include <list>
+ #include <vector>
+ #include <unordered_map>
+ #include <memory>
+ #include <atomic>
  #include <udjat/tools/xml.h>
 
  namespace Udjat {
@@ -44,26 +50,138 @@
 			class UDJAT_API Connection {
 			private:
 
-				/// @brief Mutex for serialization.
-				static std::mutex guard;
+				friend class Udjat::DBus::Interface;
+
+				/// @brief Guard for the subscription list.
+				/// @details Signal dispatch takes it shared only to get the routing table, changes on subscriptions take it exclusive.
+				std::shared_mutex guard;
 
 				/// @brief The connection name.
 				std::string object_name;
 
-				/// @brief Service thread.
-				std::thread * thread = nullptr;
+				/// @brief Dedicated I/O and dispatch thread, nullptr when running on the main loop.
+				class Service;
+				std::atomic<Service *> service{nullptr};
+
+				/// @brief Serializes start_thread() and stop_thread().
+				std::mutex threading;
+
+				/// @brief Number of wakeup() calls using the service, stop_thread() waits for them before deleting it.
+				std::atomic<unsigned int> waking{0};
+
+				/// @brief Set main loop watch and timeout functions.
+				void bind();
+
+				/// @brief Limits for dispatching messages on each main loop wakeup, zero means unlimited.
+				struct {
+					unsigned int messages = 64;		///< @brief Maximum number of messages.
+					unsigned int milliseconds = 5;	///< @brief Maximum time.
+				} budget;
+
+				/// @brief Outgoing queue limits for enqueue(), in bytes.
+				struct {
+					size_t high = 4194304;		///< @brief Apply the policy when the queue reaches this size.
+					size_t low = 1048576;		///< @brief Stop applying the policy when the queue drains to this size.
+					uint8_t policy = 0;			///< @brief The OutgoingPolicy.
+					std::atomic<bool> over{false};
+					std::atomic<size_t> dropped{0};
+				} watermarks;
+
+				/// @brief Check the outgoing queue limits before enqueueing.
+				/// @return false if the policy dropped the message.
+				bool admit();
+
+				/// @brief Send message, using a copy if it was already sent to another connection.
+				void send(DBusMessage *message);
+
+				/// @brief Main loop handler for dispatching the messages left by the budget.
+				class Dispatcher;
+				Dispatcher * dispatcher = nullptr;
 
 				/// @brief Handle signal
 				DBusHandlerResult on_signal(DBusMessage *message) noexcept;
 
+				/// @brief Exported methods, nullptr if none was registered.
+				class ObjectServer;
+				ObjectServer * server = nullptr;
+
+				/// @brief Handle method call
+				DBusHandlerResult on_method(DBusMessage *message) noexcept;
+
 				/// @brief Message filter method.
 				static DBusHandlerResult filter(DBusConnection *, DBusMessage *, Abstract::DBus::Connection *) noexcept;
 
 				/// @brief Interfaces in this connection.
 				std::list<Udjat::DBus::Interface> interfaces;
 
-				void insert(const Udjat::DBus::Interface &interface);
-				void remove(const Udjat::DBus::Interface &interface);
+				/// @brief Signal route.
+				struct Route {
+					const Udjat::DBus::Interface *interface;
+					const Udjat::DBus::Member *member;
+				};
+
+				/// @brief Signal routing table, indexed by the combined hash of interface and member names.
+				typedef std::unordered_map<size_t,std::vector<Route>> Routes;
+
+				/// @brief Current routing table.
+				/// @details Never changed after published, subscription changes replace it with a new one; the
+				/// signal dispatch runs on its own reference without holding the guard, so the callbacks can
+				/// subscribe and unsubscribe.
+				std::shared_ptr<const Routes> routes;
+
+				/// @brief Rebuild the routing table, must be called with the guard locked.
+				void reindex();
+
+				/// @brief Number of signal dispatches in progress.
+				std::atomic<size_t> dispatching{0};
+
+				/// @brief Members and interfaces removed while dispatching, released after the last dispatch.
+				struct {
+					std::atomic<bool> pending{false};
+					std::list<Udjat::DBus::Member> members;
+					std::list<Udjat::DBus::Interface> interfaces;
+				} retired;
+
+				/// @brief Release the retired members if no dispatch is in progress; must be called with the guard locked.
+				void purge() noexcept;
+
+				/// @brief Active match rules and the number of subscriptions using them.
+				std::unordered_map<std::string,size_t> rules;
+
+				/// @brief Add match rule, send it to the bus only on first use; must be called with the guard locked.
+				/// @details The AddMatch call is asynchronous, the failure is reported when the reply arrives.
+				/// @param failed Callback for the bus refusing the rule.
+				void add_match(const std::string &rule, const std::function<void(const char *rule, const char *message)> &failed);
+
+				/// @brief Release match rule, remove it from the bus on last use; must be called with the guard locked.
+				void remove_match(const std::string &rule) noexcept;
+
+				/// @brief Find interface, insert it if not found; must be called with the guard locked.
+				Udjat::DBus::Interface & find_interface(const char *interface);
+
+				/// @brief Owners of the well-known sender names, tracked until the connection closes.
+				std::unordered_map<std::string,std::shared_ptr<Udjat::DBus::Member::Owner>> owners;
+
+				/// @brief Get the owner of a well-known name, start tracking it if needed; must be called with the guard locked.
+				/// @details The bus daemon matches the sender rule against the owner, but other subscriptions
+				/// can be wider; the members check the sender locally against the tracked owner.
+				std::shared_ptr<Udjat::DBus::Member::Owner> owner(const std::string &name);
+
+				/// @brief Set the owner of the member's well-known sender; must be called with the guard locked.
+				void track(Udjat::DBus::Member &member) noexcept;
+
+				/// @brief Add match rule for the new member, the caller must reindex; must be called with the guard locked.
+				Udjat::DBus::Member & activate(Udjat::DBus::Interface &interface, Udjat::DBus::Member &member, const std::function<void(const char *rule, const char *message)> &failed);
+
+				/// @brief Get default handler for match rules refused by the bus.
+				std::function<void(const char *rule, const char *message)> failed() const;
+
+				/// @brief Add the interface-wide match rule and route the members added to the interface; must be called with the guard locked.
+				void watch(Udjat::DBus::Interface &interface);
+
+				/// @brief Insert a member on a watched interface and update routes.
+				/// @param emplace Inserts the member, called with the guard locked.
+				Udjat::DBus::Member & insert(const std::function<Udjat::DBus::Member &()> &emplace);
 
 			protected:
 
@@ -82,6 +200,24 @@
 
 			public:
 
+				/// @brief Signal subscription for batched subscribe.
+				struct UDJAT_API Subscription {
+
+					std::string interface;
+					std::string member;
+					Udjat::DBus::Member::Filter filter;
+					Udjat::DBus::Member::Dispatch dispatch;
+					std::function<void(Udjat::DBus::Message &message)> callback;
+
+					Subscription(const char *interface, const char *member, const std::function<void(Udjat::DBus::Message &message)> &callback);
+					Subscription(const char *interface, const char *member, const Udjat::DBus::Member::Filter &filter, const std::function<void(Udjat::DBus::Message &message)> &callback);
+					Subscription(const char *interface, const char *member, const Udjat::DBus::Member::Filter &filter, const Udjat::DBus::Member::Dispatch &dispatch, const std::function<void(Udjat::DBus::Message &message)> &callback);
+
+					/// @brief Get subscription from 'dbus-interface', 'dbus-member', the filter and the dispatch attributes.
+					Subscription(const XML::Node &node, const std::function<void(Udjat::DBus::Message &message)> &callback);
+
+				};
+
 				inline const char *name() const noexcept {
 					return object_name.c_str();
 				}
@@ -92,11 +228,50 @@
 
 				virtual ~Connection();
 
+				/// @brief Get the process-wide shared connection to the bus, open it on first use.
+				/// @param type The bus type.
+				/// @return The shared connection, kept open while referenced.
+				static std::shared_ptr<Connection> getInstance(DBusBusType type);
+
+				/// @brief Release the shared connections, they will be closed when the last user drops its reference.
+				static void release() noexcept;
+
 				void flush() noexcept;
 
+				/// @brief Set the limits for dispatching messages on each main loop wakeup.
+				/// @param messages Maximum number of messages, zero for unlimited.
+				/// @param milliseconds Maximum time, zero for unlimited.
+				void set_dispatch_budget(unsigned int messages, unsigned int milliseconds) noexcept;
+
+				/// @brief Dispatch incoming messages within the budget.
+				/// @return true if there are messages left.
+				bool dispatch() noexcept;
+
+				/// @brief Schedule dispatching of the pending messages on the next wakeup.
+				void wakeup() noexcept;
+
+				/// @brief Move the I/O and the message dispatch of this connection to a dedicated thread.
+				/// @details Signal callbacks will run on the new thread, use post() to get back to the main loop.
+				void start_thread();
+
+				/// @brief Stop the dedicated thread, return the I/O to the main loop.
+				/// @details From the dedicated thread itself the thread is detached, it leaves at the end of the current dispatch.
+				void stop_thread();
+
+				/// @brief Check if the connection has a dedicated thread.
+				inline bool threaded() const noexcept {
+					return service.load() != nullptr;
+				}
+
+				/// @brief Run method on the main loop thread.
+				void post(const std::function<void()> &method);
+
 				void push_back(Udjat::DBus::Interface &interface);
 				void push_back(const XML::Node &node);
 
+				/// @brief Get interface, start watching it if needed.
+				/// @details Receives all signals of the interface, the members added directly are routed by the connection;
+				/// subscribe() narrows the match rule to the member.
 				Udjat::DBus::Interface & emplace_back(const char *interface);
 
 				inline auto begin() const {
@@ -108,15 +283,88 @@
 				}
 
 				/// @brief Emit signal.
+				/// @details Waits for the socket to drain.
 				void signal(const Udjat::DBus::Signal &sig);
 
+				/// @brief Emit signals, flushing once.
+				void signal(const Udjat::DBus::SignalBatch &batch);
+
+				/// @brief What enqueue() does when the outgoing queue is over the high watermark.
+				enum OutgoingPolicy : uint8_t {
+					Block,		///< @brief Wait for the socket to drain.
+					Drop		///< @brief Discard the signals until the queue drains to the low watermark.
+				};
+
+				/// @brief Emit signal without waiting, the connection sends it when the socket is writable.
+				/// @return false if the signal was dropped by the outgoing queue policy.
+				bool enqueue(const Udjat::DBus::Signal &sig);
+
+				/// @brief Emit signals without waiting, the policy is applied to the whole batch.
+				/// @return false if the batch was dropped by the outgoing queue policy.
+				bool enqueue(const Udjat::DBus::SignalBatch &batch);
+
+				/// @brief Get the size of the outgoing queue, in bytes.
+				size_t outgoing() const noexcept;
+
+				/// @brief Set the outgoing queue limits for enqueue().
+				/// @param high Apply the policy when the queue reaches this size, in bytes.
+				/// @param low Stop applying the policy when the queue drains to this size, in bytes.
+				void set_outgoing_limits(size_t high, size_t low, OutgoingPolicy policy = Block);
+
 				/// @brief Subscribe to d-bus signal.
 				/// @return Member handling the signal.
 				Udjat::DBus::Member & subscribe(const char *interface, const char *member, const std::function<void(Udjat::DBus::Message &message)> &callback);
 
+				/// @brief Subscribe to d-bus signal with a narrowed match rule.
+				/// @param filter The path, sender and argument keys for the match rule.
+				/// @return Member handling the signal.
+				Udjat::DBus::Member & subscribe(const char *interface, const char *member, const Udjat::DBus::Member::Filter &filter, const std::function<void(Udjat::DBus::Message &message)> &callback);
+
+				/// @brief Subscribe to d-bus signal, handling it outside the connection thread.
+				/// @param filter The path, sender and argument keys for the match rule.
+				/// @param dispatch How the callback is executed, queued signals are delivered in order.
+				/// @return Member handling the signal.
+				Udjat::DBus::Member & subscribe(const char *interface, const char *member, const Udjat::DBus::Member::Filter &filter, const Udjat::DBus::Member::Dispatch &dispatch, const std::function<void(Udjat::DBus::Message &message)> &callback);
+
+				/// @brief Subscribe to several d-bus signals at once.
+				/// @details All match rules are sent as pipelined AddMatch calls, without waiting for the replies.
+				/// @param failed Called from the main loop for each match rule refused by the bus.
+				/// @return Members handling the signals, in the same order of the subscriptions.
+				std::vector<Udjat::DBus::Member *> subscribe(const std::vector<Subscription> &subscriptions, const std::function<void(const char *rule, const char *message)> &failed);
+
+				/// @brief Subscribe to d-bus signals defined by the children of a XML node.
+				/// @param node Parent node, each child named 'tagname' is a subscription.
+				/// @return Members handling the signals.
+				std::vector<Udjat::DBus::Member *> subscribe(const XML::Node &node, const char *tagname, const std::function<void(Udjat::DBus::Message &message)> &callback);
+
+				/// @brief Subscribe to d-bus signal from XML definition.
+				/// @param node XML node with 'dbus-interface', 'dbus-member', the filter and the dispatch attributes.
+				/// @return Member handling the signal.
+				Udjat::DBus::Member & subscribe(const XML::Node &node, const std::function<void(Udjat::DBus::Message &message)> &callback);
+
 				/// @brief Unsubscribe from d-bus signal.
+				/// @details Safe to call from the signal callback, including the member's own, the member is
+				/// released when the dispatch in progress finishes.
 				void remove(const Udjat::DBus::Member &member);
 
+				/// @brief Answer method calls on object path.
+				/// @details The handler runs on the connection thread; the reply is sent when the handler releases
+				/// the request, keep a reference to it to reply later from any thread without blocking the connection.
+				void register_method(const char *path, const char *interface, const char *member, const Udjat::DBus::Method &method);
+
+				/// @brief Answer method calls on object path, running the handler outside the connection thread.
+				/// @details The calls of each method are queued and handled one at a time, in arrival order, on the pool
+				/// or on the dedicated thread; the limit is the queue size, not a number of parallel handlers. To answer
+				/// many concurrent calls register the method inline and keep the request, replying from any thread when
+				/// the result is ready.
+				/// @param dispatch How the handler is executed; coalescing and time window are ignored, each call gets a reply.
+				void register_method(const char *path, const char *interface, const char *member, const Udjat::DBus::Member::Dispatch &dispatch, const Udjat::DBus::Method &method);
+
+				/// @brief Stop answering method calls on object path.
+				/// @param interface The interface name, nullptr for all interfaces.
+				/// @return Number of methods removed.
+				size_t unregister(const char *path, const char *interface = nullptr);
+
 				/// @brief Call method
 				void call(DBusMessage * message, const std::function<void(Udjat::DBus::Message & message)> &call);
 
@@ -149,6 +397,9 @@
 			SystemBus();
 			virtual ~SystemBus();
 
+			/// @brief Get the process-wide system bus connection.
+			static std::shared_ptr<SystemBus> getInstance();
+
 		};
 
 		/// @brief D-Bus shared user connection.
@@ -157,6 +408,9 @@
 			SessionBus();
 			virtual ~SessionBus();
 
+			/// @brief Get the process-wide session bus connection.
+			static std::shared_ptr<SessionBus> getInstance();
+
 		};
 
 		/// @brief D-Bus shared starter connection.
@@ -165,6 +419,9 @@
 			StarterBus();
 			virtual ~StarterBus();
 
+			/// @brief Get the process-wide starter bus connection.
+			static std::shared_ptr<StarterBus> getInstance();
+
 		};
 
 		/// @brief Private connection to an user's bus.
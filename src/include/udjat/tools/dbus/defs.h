@@ -26,14 +26,36 @@
  #pragma once
  #include <udjat/defs.h>
  #include <dbus/dbus.h>
+ #include <cstddef>
+ #include <cctype>
 
  namespace Udjat {
 
  	namespace DBus {
 
 		class Message;
+		class MessageView;
+		class Request;
 		class Value;
 		class Signal;
+		class SignalBatch;
+
+		/// @brief Get the case-insensitive hash of a D-Bus name (FNV-1a).
+		inline size_t hash(const char *name) noexcept {
+			size_t value = (size_t) 14695981039346656037ULL;
+			if(name) {
+				while(*name) {
+					value ^= (size_t) tolower(*((const unsigned char *) name++));
+					value *= (size_t) 1099511628211ULL;
+				}
+			}
+			return value;
+		}
+
+		/// @brief Combine the hashes of interface and member names.
+		inline size_t hash(size_t interface, size_t member) noexcept {
+			return interface ^ (member + 0x9e3779b9 + (interface << 6) + (interface >> 2));
+		}
 
  	}
 
@@ -0,0 +1,99 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Declares DBus::Exporter.
+  */
+
+ #pragma once
+ #include <udjat/defs.h>
+ #include <udjat/agent/abstract.h>
+ #include <udjat/tools/dbus/connection.h>
+ #include <string>
+ #include <vector>
+ #include <memory>
+
+ namespace Udjat {
+
+ 	namespace DBus {
+
+		/// @brief Export agents as d-bus objects implementing org.freedesktop.DBus.Properties.
+		/// @details Each agent is exported on the object path built from the prefix and the agent path,
+		/// with the properties 'name', 'path', 'value', 'state', 'summary' and 'level' on the interface
+		/// 'br.eti.werneck.udjat.agent'. The Get and GetAll replies are marshalled once and copied for each
+		/// call, each agent event drops only the replies of the properties it changes (value, state, summary
+		/// and level) and the changed properties are emitted as PropertiesChanged signals, in one batch per
+		/// main loop iteration. The methods 'get' and 'info' on 'br.eti.werneck.udjat.agent' answer all the
+		/// properties of the agent, as GetAll.
+		///
+		/// The module doesn't create it, the application builds the exporter after loading the agents
+		/// and requests its own bus name on the connection.
+		class UDJAT_API Exporter {
+		public:
+
+			/// @brief Exported agent.
+			class Object;
+
+			/// @brief Changed objects, waiting for the signal batch.
+			class Batch;
+
+		private:
+
+			/// @brief Connection exporting the objects.
+			std::shared_ptr<Abstract::DBus::Connection> connection;
+
+			/// @brief Prefix of the object paths.
+			std::string prefix;
+
+			std::shared_ptr<Batch> batch;
+
+			std::vector<std::shared_ptr<Object>> objects;
+
+		public:
+
+			/// @brief The interface of the agent properties.
+			static const char *interface;
+
+			/// @brief Export agent and its children.
+			/// @param connection Connection for the method calls and signals.
+			/// @param agent The agent to export, usually the root agent.
+			/// @param prefix Prefix of the object paths, empty to export the agent paths as they are.
+			Exporter(std::shared_ptr<Abstract::DBus::Connection> connection, std::shared_ptr<Abstract::Agent> agent, const char *prefix = "");
+			Exporter(const Exporter &) = delete;
+			Exporter(const Exporter *) = delete;
+
+			~Exporter();
+
+			/// @brief Export agent and its children, the agents already exported are ignored.
+			void push_back(std::shared_ptr<Abstract::Agent> agent);
+
+			/// @brief Get the object path of an agent path.
+			/// @details Characters other than letters and digits, '_' included, are escaped as '_' and the hexadecimal code.
+			std::string path(const char *agentpath) const;
+
+			/// @brief Get the number of exported agents.
+			inline size_t size() const noexcept {
+				return objects.size();
+			}
+
+		};
+
+ 	}
+
+ }
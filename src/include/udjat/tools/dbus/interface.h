@@ -25,20 +25,40 @@
  #include <udjat/defs.h>
  #include <string>
  #include <udjat/tools/xml.h>
+ #include <udjat/tools/dbus/defs.h>
  #include <udjat/tools/dbus/member.h>
  #include <list>
  #include <functional>
 
  namespace Udjat {
 
+	namespace Abstract {
+
+		namespace DBus {
+
+			class Connection;
+
+		}
+
+	}
+
 	namespace DBus {
 
 		class UDJAT_API Interface : public std::string {
 		private:
 
+			friend class Abstract::DBus::Connection;
+
 			const char *type;
 			std::list<Udjat::DBus::Member> members;
 
+			/// @brief The connection watching this interface, nullptr if not watched.
+			/// @details The members added to a watched interface are routed by the connection.
+			Abstract::DBus::Connection *connection = nullptr;
+
+			/// @brief Precomputed hash of the interface name.
+			size_t hashvalue;
+
 		public:
 			Interface(const char *name);
 			Interface(const XML::Node &node);
@@ -47,16 +67,29 @@
 
 			bool operator==(const char *intf) const noexcept;
 
+			inline size_t hash() const noexcept {
+				return hashvalue;
+			}
+
 			inline bool empty() const noexcept {
 				return members.empty();
 			}
 
 			Udjat::DBus::Member & push_back(const XML::Node &node,const std::function<void(Message & message)> &callback);
 			Udjat::DBus::Member & emplace_back(const char *member, const std::function<void(Message & message)> &callback);
+			Udjat::DBus::Member & emplace_back(const char *member, const Member::Filter &filter, const std::function<void(Message & message)> &callback);
+			Udjat::DBus::Member & emplace_back(const char *member, const Member::Filter &filter, const Member::Dispatch &dispatch, const std::function<void(Message & message)> &callback);
 
 			void remove(const Udjat::DBus::Member &member);
 
-			/// @brief Get textual form of match rule for this interface.
+			/// @brief Move the member to another list without reallocating it.
+			/// @param to The list receiving the member, it will be valid until removed from there.
+			void splice(const Udjat::DBus::Member &member, std::list<Udjat::DBus::Member> &to);
+
+			/// @brief Check if the member belongs to this interface.
+			bool contains(const Udjat::DBus::Member &member) const noexcept;
+
+			/// @brief Get textual form of match rule for the whole interface.
 			const std::string rule() const;
 
 			inline auto begin() const noexcept {
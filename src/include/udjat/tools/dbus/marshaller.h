@@ -0,0 +1,419 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Declare the typed D-Bus marshalling.
+  */
+
+ #pragma once
+ #include <udjat/defs.h>
+ #include <dbus/dbus.h>
+ #include <string>
+ #include <string_view>
+ #include <vector>
+ #include <map>
+ #include <stdexcept>
+ #include <type_traits>
+ #include <cstddef>
+
+ namespace Udjat {
+
+ 	namespace DBus {
+
+		/// @brief Compile time D-Bus signature.
+		template<char... C>
+		struct Signature {
+			static constexpr char value[sizeof...(C)+1] = {C...,'\0'};
+			static constexpr size_t length = sizeof...(C);
+		};
+
+		/// @brief Concatenate signatures.
+		template<typename... S>
+		struct Concat;
+
+		template<>
+		struct Concat<> {
+			using type = Signature<>;
+		};
+
+		template<char... A>
+		struct Concat<Signature<A...>> {
+			using type = Signature<A...>;
+		};
+
+		template<char... A, char... B, typename... Rest>
+		struct Concat<Signature<A...>,Signature<B...>,Rest...> : Concat<Signature<A...,B...>,Rest...> {
+		};
+
+		/// @brief Append and read a C++ type to/from a D-Bus message iterator.
+		/// @details Specialized for the basic types, std::string, std::string_view, DBus::Span, std::vector and std::map.
+		template<typename T>
+		struct Marshaller;
+
+		/// @brief Marshaller for basic types stored as-is in DBusBasicValue.
+		template<typename T, char C>
+		struct BasicMarshaller {
+
+			using signature = Signature<C>;
+
+			static void append(DBusMessageIter *iter, const T &value) {
+				if(!dbus_message_iter_append_basic(iter,C,&value)) {
+					throw std::runtime_error("Can't add value to d-bus iterator");
+				}
+			}
+
+			/// @brief Get value, the caller must check the type.
+			static void pop(DBusMessageIter *iter, T &value) {
+				dbus_message_iter_get_basic(iter,&value);
+				dbus_message_iter_next(iter);
+			}
+
+		};
+
+		/// @brief Types stored as contiguous blocks on d-bus arrays.
+		/// @details Boolean is excluded, the wire type is dbus_bool_t, not bool.
+		template<typename T>
+		struct is_fixed : std::false_type { };
+
+		template<> struct is_fixed<uint8_t> : std::true_type { };
+		template<> struct is_fixed<int16_t> : std::true_type { };
+		template<> struct is_fixed<uint16_t> : std::true_type { };
+		template<> struct is_fixed<int32_t> : std::true_type { };
+		template<> struct is_fixed<uint32_t> : std::true_type { };
+		template<> struct is_fixed<int64_t> : std::true_type { };
+		template<> struct is_fixed<uint64_t> : std::true_type { };
+		template<> struct is_fixed<double> : std::true_type { };
+
+		/// @brief Read only view of a contiguous array of fixed type elements.
+		/// @details When read from a message the view points to the message buffer and is valid while the message exists.
+		template<typename T>
+		class Span {
+		private:
+			const T *ptr = nullptr;
+			size_t length = 0;
+
+		public:
+			static_assert(is_fixed<T>::value,"Span requires a fixed size d-bus type");
+
+			constexpr Span() = default;
+
+			constexpr Span(const T *p, size_t l) : ptr{p}, length{l} {
+			}
+
+			/// @brief View over a contiguous container (std::vector, std::array, ...).
+			template<typename C, typename = decltype(std::declval<const C &>().data()), typename = decltype(std::declval<const C &>().size())>
+			constexpr Span(const C &container) : ptr{container.data()}, length{container.size()} {
+			}
+
+			inline const T * data() const noexcept {
+				return ptr;
+			}
+
+			inline size_t size() const noexcept {
+				return length;
+			}
+
+			inline bool empty() const noexcept {
+				return length == 0;
+			}
+
+			inline const T * begin() const noexcept {
+				return ptr;
+			}
+
+			inline const T * end() const noexcept {
+				return ptr+length;
+			}
+
+			inline const T & operator[](size_t ix) const noexcept {
+				return ptr[ix];
+			}
+
+		};
+
+		template<> struct Marshaller<uint8_t> : BasicMarshaller<uint8_t,DBUS_TYPE_BYTE> { };
+		template<> struct Marshaller<int16_t> : BasicMarshaller<int16_t,DBUS_TYPE_INT16> { };
+		template<> struct Marshaller<uint16_t> : BasicMarshaller<uint16_t,DBUS_TYPE_UINT16> { };
+		template<> struct Marshaller<int32_t> : BasicMarshaller<int32_t,DBUS_TYPE_INT32> { };
+		template<> struct Marshaller<uint32_t> : BasicMarshaller<uint32_t,DBUS_TYPE_UINT32> { };
+		template<> struct Marshaller<int64_t> : BasicMarshaller<int64_t,DBUS_TYPE_INT64> { };
+		template<> struct Marshaller<uint64_t> : BasicMarshaller<uint64_t,DBUS_TYPE_UINT64> { };
+		template<> struct Marshaller<double> : BasicMarshaller<double,DBUS_TYPE_DOUBLE> { };
+
+		template<>
+		struct Marshaller<bool> {
+
+			using signature = Signature<DBUS_TYPE_BOOLEAN>;
+
+			static void append(DBusMessageIter *iter, const bool &value) {
+				dbus_bool_t dvalue = value;
+				if(!dbus_message_iter_append_basic(iter,DBUS_TYPE_BOOLEAN,&dvalue)) {
+					throw std::runtime_error("Can't add value to d-bus iterator");
+				}
+			}
+
+			static void pop(DBusMessageIter *iter, bool &value) {
+				dbus_bool_t dvalue;
+				dbus_message_iter_get_basic(iter,&dvalue);
+				dbus_message_iter_next(iter);
+				value = (dvalue != 0);
+			}
+
+		};
+
+		template<>
+		struct Marshaller<const char *> {
+
+			using signature = Signature<DBUS_TYPE_STRING>;
+
+			static void append(DBusMessageIter *iter, const char * const &value) {
+				if(!dbus_message_iter_append_basic(iter,DBUS_TYPE_STRING,&value)) {
+					throw std::runtime_error("Can't add value to d-bus iterator");
+				}
+			}
+
+			/// @brief Get string, the pointer is valid while the message exists.
+			static void pop(DBusMessageIter *iter, const char * &value) {
+				dbus_message_iter_get_basic(iter,&value);
+				dbus_message_iter_next(iter);
+			}
+
+		};
+
+		template<>
+		struct Marshaller<char *> : Marshaller<const char *> {
+		};
+
+		template<>
+		struct Marshaller<std::string> {
+
+			using signature = Signature<DBUS_TYPE_STRING>;
+
+			static void append(DBusMessageIter *iter, const std::string &value) {
+				Marshaller<const char *>::append(iter,value.c_str());
+			}
+
+			static void pop(DBusMessageIter *iter, std::string &value) {
+				const char *str;
+				dbus_message_iter_get_basic(iter,&str);
+				dbus_message_iter_next(iter);
+				value.assign(str);
+			}
+
+		};
+
+		/// @brief Marshaller for arrays of fixed type, the elements are copied in one call.
+		template<typename T>
+		struct Marshaller<Span<T>> {
+
+			using signature = typename Concat<Signature<DBUS_TYPE_ARRAY>,typename Marshaller<T>::signature>::type;
+
+			static void append(DBusMessageIter *iter, const Span<T> &values) {
+
+				DBusMessageIter array;
+				if(!dbus_message_iter_open_container(iter,DBUS_TYPE_ARRAY,Marshaller<T>::signature::value,&array)) {
+					throw std::runtime_error("Can't open d-bus array");
+				}
+
+				const T *ptr = values.data();
+				if(!dbus_message_iter_append_fixed_array(&array,Marshaller<T>::signature::value[0],&ptr,(int) values.size())) {
+					dbus_message_iter_abandon_container(iter,&array);
+					throw std::runtime_error("Can't add fixed array to d-bus iterator");
+				}
+
+				if(!dbus_message_iter_close_container(iter,&array)) {
+					throw std::runtime_error("Can't close d-bus array");
+				}
+
+			}
+
+			/// @brief Get view of the message buffer, the caller must check the type.
+			static void pop(DBusMessageIter *iter, Span<T> &values) {
+
+				DBusMessageIter array;
+				dbus_message_iter_recurse(iter,&array);
+
+				const T *ptr = nullptr;
+				int length = 0;
+				if(dbus_message_iter_get_arg_type(&array) != DBUS_TYPE_INVALID) {
+					dbus_message_iter_get_fixed_array(&array,&ptr,&length);
+				}
+				values = Span<T>{ptr,(size_t) length};
+
+				dbus_message_iter_next(iter);
+
+			}
+
+		};
+
+		template<>
+		struct Marshaller<std::string_view> {
+
+			using signature = Signature<DBUS_TYPE_STRING>;
+
+			static void append(DBusMessageIter *iter, const std::string_view &value) {
+				// The d-bus string must be nul terminated.
+				Marshaller<std::string>::append(iter,std::string{value});
+			}
+
+			/// @brief Get view of the message buffer, valid while the message exists.
+			static void pop(DBusMessageIter *iter, std::string_view &value) {
+				const char *str;
+				dbus_message_iter_get_basic(iter,&str);
+				dbus_message_iter_next(iter);
+				value = str;
+			}
+
+		};
+
+		template<typename T>
+		struct Marshaller<std::vector<T>> {
+
+			using signature = typename Concat<Signature<DBUS_TYPE_ARRAY>,typename Marshaller<T>::signature>::type;
+
+			static void append(DBusMessageIter *iter, const std::vector<T> &values) {
+
+				if constexpr (is_fixed<T>::value) {
+					Marshaller<Span<T>>::append(iter,Span<T>{values});
+					return;
+				}
+
+				DBusMessageIter array;
+				if(!dbus_message_iter_open_container(iter,DBUS_TYPE_ARRAY,Marshaller<T>::signature::value,&array)) {
+					throw std::runtime_error("Can't open d-bus array");
+				}
+
+				try {
+					for(const T &value : values) {
+						Marshaller<T>::append(&array,value);
+					}
+				} catch(...) {
+					dbus_message_iter_abandon_container(iter,&array);
+					throw;
+				}
+
+				if(!dbus_message_iter_close_container(iter,&array)) {
+					throw std::runtime_error("Can't close d-bus array");
+				}
+
+			}
+
+			static void pop(DBusMessageIter *iter, std::vector<T> &values) {
+
+				if constexpr (is_fixed<T>::value) {
+					Span<T> span;
+					Marshaller<Span<T>>::pop(iter,span);
+					values.assign(span.begin(),span.end());
+					return;
+				}
+
+				DBusMessageIter array;
+				dbus_message_iter_recurse(iter,&array);
+
+				values.clear();
+				while(dbus_message_iter_get_arg_type(&array) != DBUS_TYPE_INVALID) {
+					values.emplace_back();
+					Marshaller<T>::pop(&array,values.back());
+				}
+
+				dbus_message_iter_next(iter);
+
+			}
+
+		};
+
+		template<typename K, typename V>
+		struct Marshaller<std::map<K,V>> {
+
+			using entry = typename Concat<
+								Signature<DBUS_DICT_ENTRY_BEGIN_CHAR>,
+								typename Marshaller<K>::signature,
+								typename Marshaller<V>::signature,
+								Signature<DBUS_DICT_ENTRY_END_CHAR>
+							>::type;
+
+			using signature = typename Concat<Signature<DBUS_TYPE_ARRAY>,entry>::type;
+
+			static void append(DBusMessageIter *iter, const std::map<K,V> &values) {
+
+				DBusMessageIter array;
+				if(!dbus_message_iter_open_container(iter,DBUS_TYPE_ARRAY,entry::value,&array)) {
+					throw std::runtime_error("Can't open d-bus dictionary");
+				}
+
+				try {
+					for(const auto &value : values) {
+
+						DBusMessageIter item;
+						if(!dbus_message_iter_open_container(&array,DBUS_TYPE_DICT_ENTRY,NULL,&item)) {
+							throw std::runtime_error("Can't open d-bus dictionary entry");
+						}
+
+						Marshaller<K>::append(&item,value.first);
+						Marshaller<V>::append(&item,value.second);
+
+						if(!dbus_message_iter_close_container(&array,&item)) {
+							throw std::runtime_error("Can't close d-bus dictionary entry");
+						}
+
+					}
+				} catch(...) {
+					dbus_message_iter_abandon_container(iter,&array);
+					throw;
+				}
+
+				if(!dbus_message_iter_close_container(iter,&array)) {
+					throw std::runtime_error("Can't close d-bus dictionary");
+				}
+
+			}
+
+			static void pop(DBusMessageIter *iter, std::map<K,V> &values) {
+
+				DBusMessageIter array;
+				dbus_message_iter_recurse(iter,&array);
+
+				values.clear();
+				while(dbus_message_iter_get_arg_type(&array) == DBUS_TYPE_DICT_ENTRY) {
+
+					DBusMessageIter item;
+					dbus_message_iter_recurse(&array,&item);
+
+					K key;
+					Marshaller<K>::pop(&item,key);
+					Marshaller<V>::pop(&item,values[key]);
+
+					dbus_message_iter_next(&array);
+				}
+
+				dbus_message_iter_next(iter);
+
+			}
+
+		};
+
+		/// @brief Get the D-Bus signature for the types.
+		template<typename... T>
+		constexpr const char * signature() noexcept {
+			return Concat<typename Marshaller<typename std::decay<T>::type>::signature...>::type::value;
+		}
+
+ 	}
+
+ }
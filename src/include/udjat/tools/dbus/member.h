@@ -25,30 +25,155 @@
 
  #pragma once
  #include <udjat/defs.h>
+ #include <dbus/dbus.h>
+ #include <udjat/tools/dbus/defs.h>
  #include <udjat/tools/dbus/message.h>
  #include <string>
+ #include <vector>
  #include <functional>
+ #include <atomic>
+ #include <memory>
  #include <udjat/tools/xml.h>
 
  namespace Udjat {
 
+	namespace Abstract {
+
+		namespace DBus {
+
+			class Connection;
+
+		}
+
+	}
+
 	namespace DBus {
 
 		class UDJAT_API Member : public std::string {
+		public:
+
+			/// @brief Match rule keys narrowing the subscription, empty values are ignored.
+			struct UDJAT_API Filter {
+
+				std::string path;				///< @brief Object path emitting the signal ('path').
+				std::string path_namespace;		///< @brief Object path or any of its children ('path_namespace').
+				std::string sender;				///< @brief Bus name sending the signal ('sender').
+				std::vector<std::string> args;	///< @brief String arguments by position ('argN').
+
+				Filter() = default;
+
+				/// @brief Get filter from 'dbus-path', 'dbus-path-namespace', 'dbus-sender' and 'dbus-argN' attributes.
+				Filter(const XML::Node &node);
+
+			};
+
+			/// @brief How the signal handler is executed.
+			struct UDJAT_API Dispatch {
+
+				enum Mode : uint8_t {
+					Inline,		///< @brief On the connection thread, while dispatching the signal.
+					Pool,		///< @brief On the thread pool, one signal at a time in arrival order.
+					Serial		///< @brief On a dedicated thread, in arrival order.
+				} mode = Inline;
+
+				/// @brief How pending signals are coalesced.
+				enum Coalesce : uint8_t {
+					None,		///< @brief Every signal is delivered.
+					Latest,		///< @brief A new signal replaces the pending ones, superseded signals are never decoded.
+					Merge		///< @brief Pending 'sa{sv}as' signals (like PropertiesChanged) for the same path and first argument are merged by key.
+				} coalesce = None;
+
+				/// @brief Time window in milliseconds, signals received during it are delivered together when it ends.
+				/// @details The handler runs at most once per window; with inline mode the delivery happens on the main loop.
+				unsigned long window = 0;
+
+				/// @brief Maximum number of queued signals, when full the dispatch waits for the handler.
+				size_t limit = 128;
+
+				Dispatch() = default;
+
+				Dispatch(Mode m, size_t l = 128) : mode{m}, limit{l} {
+				}
+
+				Dispatch(Mode m, Coalesce c, unsigned long w = 0, size_t l = 128) : mode{m}, coalesce{c}, window{w}, limit{l} {
+				}
+
+				/// @brief Get settings from 'dbus-dispatch' ('inline', 'pool' or 'serial'), 'dbus-coalesce' ('none', 'latest' or 'merge'),
+				/// 'dbus-window' and 'dbus-queue-size' attributes.
+				Dispatch(const XML::Node &node);
+
+			};
+
+			class Queue;
+
 		private:
+
 			std::function<void(Message & message)> callback;	// Cant be reference!!
 
+			/// @brief Precomputed hash of the member name.
+			size_t hashvalue;
+
+			/// @brief The subscription filter.
+			Filter filter;
+
+			/// @brief The execution settings.
+			Dispatch dispatch;
+
+			/// @brief Owner of the sender name.
+			class Owner;
+
+			/// @brief Tracked owner of a well-known sender, empty if not filtering by sender.
+			std::shared_ptr<Owner> owner;
+
+			/// @brief Pending signals, empty on inline dispatch without time window.
+			std::shared_ptr<Queue> queue;
+
+			/// @brief Create the signal queue, if required by the execution settings.
+			static std::shared_ptr<Queue> QueueFactory(const char *name, const Dispatch &dispatch, const std::function<void(Message & message)> &callback);
+
+			/// @brief False after unsubscribe, a dispatch already in progress will skip the member.
+			mutable std::atomic<bool> active{true};
+
+			/// @brief True if the member added its own match rule, false if routed by a watched interface.
+			bool matched = false;
+
+			friend class Abstract::DBus::Connection;
+
 		public:
+			Member(const Member &src);
 			Member(const char *name,const std::function<void(Message & message)> &callback);
+			Member(const char *name,const Filter &filter,const std::function<void(Message & message)> &callback);
+			Member(const char *name,const Filter &filter,const Dispatch &dispatch,const std::function<void(Message & message)> &callback);
 			Member(const XML::Node &node,const std::function<void(Message & message)> &callback);
 			~Member();
 
 			bool operator==(const char *name) const noexcept;
 
+			/// @brief Get textual form of the narrowest match rule for this member.
+			/// @param interface The interface name.
+			std::string rule(const char *interface) const;
+
+			/// @brief Check the filter against a received signal.
+			/// @return true if the signal is for this member.
+			bool matches(DBusMessage *message) const noexcept;
+
+			inline size_t hash() const noexcept {
+				return hashvalue;
+			}
+
+			/// @brief Check if the member still receives signals.
+			inline bool subscribed() const noexcept {
+				return active.load(std::memory_order_acquire);
+			}
+
 			inline void call(Message &message) const {
 				callback(message);
 			}
 
+			/// @brief Handle received signal according to the execution settings.
+			/// @details Queued dispatch waits while the queue is full.
+			void call(DBusMessage *message) const;
+
 		};
 
 	}
@@ -26,6 +26,8 @@
  #include <dbus/dbus.h>
  #include <string>
  #include <udjat/tools/dbus/value.h>
+ #include <udjat/tools/dbus/marshaller.h>
+ #include <tuple>
 
  namespace Udjat {
 
@@ -44,6 +46,12 @@
 
 		private:
 
+			/// @brief String storage for the decoded values.
+			std::shared_ptr<Value::Arena> arena;
+
+			/// @brief Check the signature of the current argument.
+			void check(const char *expected);
+
 			struct {
 				bool valid = false;		/// @brief True if this is an error message.
 				std::string name;		/// @brief Error name.
@@ -92,6 +100,10 @@
 
 			Message & pop(Value &value);
 
+			/// @brief Get value without copying the strings.
+			/// @details The value points to the message buffer and is valid only while the message exists, use it inside the callback.
+			Message & borrow(Value &value);
+
 			DBusMessageIter * getIter();
 
 			inline bool failed() const {
@@ -108,6 +120,23 @@
 				return *this;
 			}
 
+			/// @brief Get array of fixed type elements without copying.
+			/// @param values View of the message buffer, valid while the message exists.
+			template <typename T>
+			Message & pop(Span<T> &values) {
+				check(Marshaller<Span<T>>::signature::value);
+				Marshaller<Span<T>>::pop(&message.iter,values);
+				return *this;
+			}
+
+			/// @brief Get array of fixed type elements.
+			template <typename T>
+			Message & pop(std::vector<T> &values) {
+				check(Marshaller<std::vector<T>>::signature::value);
+				Marshaller<std::vector<T>>::pop(&message.iter,values);
+				return *this;
+			}
+
 			inline const char * error_name() const {
 				return this->err.name.c_str();
 			}
@@ -137,6 +166,50 @@
 
 			Message & push_back(const std::vector<std::string> &elements);
 
+			/// @brief Append array of fixed type elements in one call.
+			template<typename T>
+			Message & push_back(const Span<T> &values) {
+				Marshaller<Span<T>>::append(&message.iter,values);
+				return *this;
+			}
+
+			template<typename T>
+			inline Message & push_back(const std::vector<T> &values) {
+				return pack(values);
+			}
+
+			/// @brief Append typed arguments, without intermediate values.
+			template<typename... T>
+			Message & pack(const T&... values) {
+				(Marshaller<typename std::decay<T>::type>::append(&message.iter,values), ...);
+				return *this;
+			}
+
+			/// @brief Read all arguments as typed values.
+			/// @details The message signature is checked once against the compile time signature of the types.
+			/// @return Tuple with the values, use structured binding to get them.
+			template<typename... T>
+			std::tuple<T...> unpack() {
+
+				if(err.valid) {
+					throw std::runtime_error(err.message);
+				}
+
+				const char *expected = DBus::signature<T...>();
+				if(!dbus_message_has_signature(message.value,expected)) {
+					throw std::runtime_error(std::string{"Unexpected d-bus signature '"} + dbus_message_get_signature(message.value) + "', expecting '" + expected + "'");
+				}
+
+				dbus_message_iter_init(message.value,&message.iter);
+
+				std::tuple<T...> values;
+				std::apply([this](T&... value){
+					(Marshaller<T>::pop(&message.iter,value), ...);
+				},values);
+
+				return values;
+			}
+
 			std::ostream & info() const;
 			std::ostream & warning() const;
 			std::ostream & error() const;
@@ -0,0 +1,97 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Declares DBus::Proxy.
+  */
+
+ #pragma once
+ #include <udjat/defs.h>
+ #include <udjat/tools/dbus/defs.h>
+ #include <udjat/tools/dbus/connection.h>
+ #include <udjat/tools/dbus/value.h>
+ #include <string>
+ #include <memory>
+ #include <stdexcept>
+
+ namespace Udjat {
+
+ 	namespace DBus {
+
+		/// @brief Local copy of the properties of a remote object.
+		/// @details Filled with one GetAll call and kept current by the PropertiesChanged signals;
+		/// the reads don't touch the bus.
+		class UDJAT_API Proxy {
+		private:
+
+			std::shared_ptr<Abstract::DBus::Connection> connection;
+
+			/// @brief Cached properties, shared with the signal and the reply handlers.
+			class Cache;
+			std::shared_ptr<Cache> cache;
+
+			/// @brief PropertiesChanged subscription.
+			Udjat::DBus::Member *member = nullptr;
+
+		public:
+
+			/// @brief Get the properties of a remote object.
+			/// @details Blocks until the GetAll reply arrives.
+			/// @param connection The bus connection.
+			/// @param destination Bus name of the remote object.
+			/// @param path Path of the remote object.
+			/// @param interface Interface of the properties.
+			Proxy(std::shared_ptr<Abstract::DBus::Connection> connection, const char *destination, const char *path, const char *interface);
+			Proxy(const Proxy &) = delete;
+			Proxy(const Proxy *) = delete;
+
+			~Proxy();
+
+			const char * destination() const noexcept;
+			const char * path() const noexcept;
+			const char * interface() const noexcept;
+
+			/// @brief Get the number of cached properties.
+			size_t size() const;
+
+			/// @brief Check if the property is cached.
+			/// @details Invalidated properties are not cached until their new value arrives.
+			bool contains(const char *name) const;
+
+			/// @brief Get property value from cache.
+			/// @return false if the property is not cached.
+			bool get(const char *name, Udjat::DBus::Value &value) const;
+
+			/// @brief Get property value from cache.
+			template<typename T>
+			T get(const char *name) const {
+				Udjat::DBus::Value value;
+				if(!get(name,value)) {
+					throw std::runtime_error(std::string{"Property '"} + name + "' is not available");
+				}
+				T rc;
+				value.get(rc);
+				return rc;
+			}
+
+		};
+
+ 	}
+
+ }
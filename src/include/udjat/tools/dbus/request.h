@@ -0,0 +1,101 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Declares DBus::Request.
+  */
+
+ #pragma once
+ #include <udjat/defs.h>
+ #include <dbus/dbus.h>
+ #include <udjat/tools/dbus/defs.h>
+ #include <udjat/tools/dbus/view.h>
+ #include <udjat/tools/dbus/marshaller.h>
+ #include <functional>
+ #include <memory>
+ #include <atomic>
+ #include <exception>
+
+ namespace Udjat {
+
+ 	namespace DBus {
+
+		/// @brief Incoming method call and its pending reply.
+		/// @details The reply is sent when the last reference is released, keep a reference
+		/// to answer later; the reply can be built and sent from any thread.
+		class UDJAT_API Request : public MessageView {
+		private:
+
+			/// @brief Connection receiving the call, referenced.
+			DBusConnection *conn;
+
+			/// @brief The reply, created on first use.
+			DBusMessage *response = nullptr;
+			DBusMessageIter iter;
+
+			/// @brief True after the reply was sent.
+			std::atomic<bool> sent{false};
+
+			/// @brief Get the reply iterator, create the reply if needed.
+			DBusMessageIter * reply();
+
+		public:
+			Request(DBusConnection *conn, DBusMessage *message);
+			Request(const Request &) = delete;
+			Request(const Request *) = delete;
+
+			~Request();
+
+			/// @brief Check if the caller waits for a reply.
+			inline bool expects_reply() const noexcept {
+				return !dbus_message_get_no_reply((DBusMessage *) *this);
+			}
+
+			/// @brief Append typed values to the reply.
+			template<typename... T>
+			Request & pack(const T&... values) {
+				DBusMessageIter *it = reply();
+				(Marshaller<typename std::decay<T>::type>::append(it,values), ...);
+				return *this;
+			}
+
+			/// @brief Append value to the reply.
+			Request & push_back(const Value &value);
+
+			/// @brief Reply with an error, discarding the values added.
+			void failed(const char *name, const char *message) noexcept;
+
+			/// @brief Reply with 'org.freedesktop.DBus.Error.Failed'.
+			void failed(const std::exception &e) noexcept;
+
+			/// @brief Send the reply now.
+			void send() noexcept;
+
+			/// @brief Reply with a copy of a prebuilt method return, without marshalling the values again.
+			/// @param prototype Method return with the reply arguments, unchanged.
+			void send(const DBusMessage *prototype) noexcept;
+
+		};
+
+		/// @brief Method call handler.
+		using Method = std::function<void(std::shared_ptr<Request> request)>;
+
+ 	}
+
+ }
@@ -24,14 +24,42 @@
  #pragma once
  #include <udjat/defs.h>
  #include <string>
+ #include <vector>
  #include <udjat/tools/xml.h>
  #include <udjat/tools/dbus/connection.h>
+ #include <udjat/tools/dbus/marshaller.h>
  #include <dbus/dbus.h>
 
  namespace Udjat {
 
 	namespace DBus {
 
+		/// @brief Validated signal header, for emitting the same signal many times.
+		/// @details Names are checked and the header is built once, each signal is a copy of it.
+		/// The message can't be reused: libdbus locks it on send and has no call to drop the
+		/// arguments, so each emission copies the prebuilt header instead of rebuilding it.
+		class UDJAT_API SignalTemplate {
+		private:
+
+			/// @brief The D-Bus message, without arguments.
+			DBusMessage *message;
+
+		public:
+			SignalTemplate(const char *iface, const char *member, const char *path);
+			SignalTemplate(const SignalTemplate &) = delete;
+			SignalTemplate(const SignalTemplate *) = delete;
+
+			~SignalTemplate();
+
+			inline DBusMessage * dbus_message() const noexcept {
+				return message;
+			}
+
+			/// @brief Check if the template has the same names.
+			bool matches(const char *iface, const char *member, const char *path) const noexcept;
+
+		};
+
 		class UDJAT_API Signal {
 		private:
 
@@ -52,8 +80,21 @@
 			}
 
 		public:
+			Signal(const Signal &) = delete;
+			Signal(const Signal *) = delete;
+
 			Signal(const char *iface, const char *member, const char *path);
 
+			/// @brief Build signal from template, without validating the names again.
+			Signal(const SignalTemplate &tmpl);
+
+			template<typename T, typename... Targs>
+			Signal(const SignalTemplate &tmpl, const T &value, Targs... Fargs)
+				: Signal(tmpl) {
+				push_back(value);
+				add(Fargs...);
+			}
+
 			template<typename T, typename... Targs>
 			Signal(const char *iface, const char *member, const char *path, const T &value, Targs... Fargs)
 				: Signal(iface,member,path) {
@@ -79,6 +120,10 @@
 			/// @brief Emit signal to the connection.
 			void emit(Abstract::DBus::Connection &connection);
 
+			/// @brief Emit signal to the connection without waiting for the socket.
+			/// @return false if the signal was dropped by the connection outgoing queue policy.
+			bool enqueue(Abstract::DBus::Connection &connection);
+
 			/// @brief Emit signal directly to selected user bus.
 			void user(uid_t uid, const char *sid = "");
 
@@ -100,6 +145,67 @@
 			Signal & push_back(const int64_t value);
 			Signal & push_back(const uint64_t value);
 
+			/// @brief Append typed arguments, without intermediate values.
+			template<typename... T>
+			Signal & pack(const T&... values) {
+				(Marshaller<typename std::decay<T>::type>::append(&iter,values), ...);
+				return *this;
+			}
+
+		};
+
+		/// @brief Signals emitted together, with a single flush per connection.
+		/// @details The same batch can be emitted to several connections.
+		class UDJAT_API SignalBatch {
+		private:
+
+			/// @brief The D-Bus messages, with a reference held.
+			std::vector<DBusMessage *> messages;
+
+		public:
+			SignalBatch() = default;
+			SignalBatch(const SignalBatch &) = delete;
+			SignalBatch(const SignalBatch *) = delete;
+
+			~SignalBatch();
+
+			/// @brief Add signal to the batch.
+			/// @details The signal message is shared, don't change the signal after adding it.
+			SignalBatch & push_back(const Signal &signal);
+
+			/// @brief Build signal and add it to the batch.
+			template<typename... Targs>
+			SignalBatch & emplace_back(const char *iface, const char *member, const char *path, Targs... Fargs) {
+				Signal signal{iface,member,path,Fargs...};
+				return push_back(signal);
+			}
+
+			inline size_t size() const noexcept {
+				return messages.size();
+			}
+
+			inline bool empty() const noexcept {
+				return messages.empty();
+			}
+
+			inline auto begin() const noexcept {
+				return messages.begin();
+			}
+
+			inline auto end() const noexcept {
+				return messages.end();
+			}
+
+			/// @brief Remove all signals.
+			void clear() noexcept;
+
+			/// @brief Emit all signals to the connection, flushing once.
+			void emit(Abstract::DBus::Connection &connection) const;
+
+			/// @brief Emit all signals to the connection without waiting for the socket.
+			/// @return false if the batch was dropped by the connection outgoing queue policy.
+			bool enqueue(Abstract::DBus::Connection &connection) const;
+
 		};
 
 	}
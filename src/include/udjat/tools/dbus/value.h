@@ -26,7 +26,9 @@
  #include <dbus/dbus.h>
  #include <udjat/tools/value.h>
  #include <udjat/tools/dbus/defs.h>
- #include <map>
+ #include <udjat/tools/dbus/marshaller.h>
+ #include <vector>
+ #include <memory>
 
  namespace Udjat {
 
@@ -35,6 +37,11 @@
 
  		/// @brief D-Bus Value
 		class UDJAT_API Value : public Udjat::Value {
+		public:
+
+			/// @brief String storage shared by the values decoded from one message.
+			class Arena;
+
 		private:
 
 			/// @brief D-Bus data type.
@@ -43,8 +50,62 @@
 			/// @brief D-Bus value.
 			DBusBasicValue value;
 
-			/// @brief Value children.
-			std::map<std::string,Value *> children;
+			/// @brief Storage of string values.
+			enum Storage : uint8_t {
+				Owned,		///< @brief Allocated with strdup.
+				Inline,		///< @brief Short string on the value buffer.
+				Shared,		///< @brief Message arena.
+				Borrowed	///< @brief Message buffer, valid while the message exists.
+			} storage = Owned;
+
+			/// @brief Buffer for short strings.
+			char buffer[24];
+
+			/// @brief Set string value, short strings are stored inline.
+			void assign(const char *str);
+
+			/// @brief Children, in insertion order; empty vectors don't touch the heap.
+			/// @details Decoded arrays reserve them from the element count, in one allocation.
+			/// The references returned by append() and operator[] are valid until the next insertion.
+			std::vector<Value> children;
+
+			/// @brief Positions of the named children, sorted by name.
+			std::vector<uint32_t> index;
+
+			/// @brief Dictionary key, on the arena of the parent value; nullptr if unnamed.
+			const char *key = nullptr;
+
+			/// @brief Append unnamed child.
+			Value & emplace_back();
+
+			/// @brief Get named child, insert it if not found.
+			Value & child(const char *name);
+
+			/// @brief Search named child.
+			/// @return Child value, nullptr if not found.
+			const Value * search(const char *name) const noexcept;
+
+			/// @brief Arena with the decoded strings and signatures.
+			std::shared_ptr<Arena> arena;
+
+			/// @brief Element signature of decoded arrays and variants, nullptr for other values.
+			const char *signature = nullptr;
+
+			/// @brief Get the value inside a variant.
+			const Value & content() const;
+
+			/// @brief Contiguous storage for arrays of fixed type elements.
+			struct {
+				int type = DBUS_TYPE_INVALID;	///< @brief Element type.
+				std::vector<uint8_t> data;		///< @brief Element values.
+			} fixed;
+
+			/// @brief Set array of fixed type elements.
+			void set(int type, const void *data, size_t length);
+
+			/// @brief Get array of fixed type elements.
+			/// @return Pointer to the elements, nullptr if the value is not an array of type.
+			const void * get(int type, size_t &length) const noexcept;
 
 			/// @brief Check if the value dont have a signature.
 			/// @return true if the value can be added on signature.
@@ -57,11 +118,15 @@
 
 		public:
 
-			// String values have an strdup; the copy can invalidate the pointer.
+			/// @brief Copy value, borrowed and inline strings are copied; arena strings are shared.
 			Value(const Value *src);
 			Value(const Value &src);
+			Value(Value &&src) noexcept;
 			Value(Message &message);
 
+			Value & operator=(const Value &src);
+			Value & operator=(Value &&src) noexcept;
+
 			Value();
 			Value(int type, const char *value = nullptr);
 			virtual ~Value();
@@ -69,15 +134,55 @@
 			/// @brief Add value on iter.
 			void get(DBusMessageIter *iter) const;
 
+			/// @brief Add value on iter, wrapped in a variant.
+			void variant(DBusMessageIter *iter) const;
+
+			/// @brief Copy value to a generic value, unwrapping variants.
+			/// @details Arrays and structs become arrays, dictionaries become objects.
+			const Udjat::Value & get(Udjat::Value &value) const;
+
 			/// @brief Set value from iter.
 			/// @return true if the value is valid.
 			bool set(DBusMessageIter *iter);
 
+			/// @brief Set value from iter, decoding containers recursively.
+			/// @param arena String storage, created on first use; share it to decode all arguments of a message.
+			/// @param borrow If true the strings point to the message buffer and the value is valid only while the message exists.
+			/// @return true if the value is valid.
+			bool set(DBusMessageIter *iter, std::shared_ptr<Arena> &arena, bool borrow = false);
+
+			/// @brief Find child by name (dictionary key).
+			/// @return Child value, nullptr if not found.
+			const Value * find(const char *name) const noexcept;
+
+			/// @brief Set value to an array of fixed type elements.
+			template<typename T>
+			Value & set(const Span<T> &values) {
+				set(Marshaller<T>::signature::value[0],values.data(),values.size() * sizeof(T));
+				return *this;
+			}
+
+			/// @brief Get view of the fixed type array, valid while the value is unchanged.
+			template<typename T>
+			Span<T> array() const {
+				size_t length = 0;
+				const T *ptr = (const T *) get(Marshaller<T>::signature::value[0],length);
+				if(!ptr) {
+					throw std::runtime_error(std::string{"Value is not an array of '"} + Marshaller<T>::signature::value + "'");
+				}
+				return Span<T>{ptr,length / sizeof(T)};
+			}
+
 			/// @brief The value has children?
 			inline bool empty() const noexcept {
 				return children.empty();
 			}
 
+			/// @brief Get the number of children.
+			inline size_t size() const noexcept {
+				return children.size();
+			}
+
 			inline bool operator==(int type) const noexcept {
 				return this->type == type;
 			}
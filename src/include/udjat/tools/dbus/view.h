@@ -0,0 +1,206 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Declares DBus::MessageView.
+  */
+
+ #pragma once
+ #include <udjat/defs.h>
+ #include <dbus/dbus.h>
+ #include <udjat/tools/dbus/defs.h>
+ #include <udjat/tools/dbus/marshaller.h>
+ #include <string_view>
+ #include <iterator>
+ #include <tuple>
+
+ namespace Udjat {
+
+ 	namespace DBus {
+
+		/// @brief Read only view of a D-Bus message.
+		/// @details Strings are returned as views of the message buffer, nothing is copied or allocated;
+		/// the view and the values are valid while the message exists (inside the signal callback).
+		class UDJAT_API MessageView {
+		private:
+			DBusMessage *message;
+
+			static inline std::string_view view(const char *str) noexcept {
+				return str ? std::string_view{str} : std::string_view{};
+			}
+
+		public:
+
+			/// @brief Message argument.
+			class UDJAT_API Argument {
+			private:
+				mutable DBusMessageIter iter;
+
+			public:
+				Argument(const DBusMessageIter &i) : iter{i} {
+				}
+
+				/// @brief Get the argument type.
+				inline int type() const noexcept {
+					return dbus_message_iter_get_arg_type(&iter);
+				}
+
+				/// @brief Check the argument signature.
+				/// @param signature The expected signature, "s" accepts any string type.
+				bool is(const char *signature) const noexcept;
+
+				/// @brief Get the argument value.
+				/// @tparam T Basic type, std::string_view or DBus::Span for zero copy; any type with a Marshaller.
+				template<typename T>
+				T get() const {
+
+					if(!is(Marshaller<T>::signature::value)) {
+						throw std::runtime_error(std::string{"Unexpected d-bus argument type, expecting '"} + Marshaller<T>::signature::value + "'");
+					}
+
+					DBusMessageIter it = iter;
+					T value;
+					Marshaller<T>::pop(&it,value);
+					return value;
+
+				}
+
+				/// @brief Get string, object path or signature as a view of the message buffer.
+				inline operator std::string_view() const {
+					return get<std::string_view>();
+				}
+
+			};
+
+			/// @brief Iterator over the message arguments.
+			class UDJAT_API Iterator {
+			private:
+				DBusMessageIter iter;
+				bool valid = false;
+
+			public:
+				using iterator_category = std::input_iterator_tag;
+				using value_type = Argument;
+				using difference_type = std::ptrdiff_t;
+				using pointer = const Argument *;
+				using reference = Argument;
+
+				Iterator() = default;
+
+				Iterator(DBusMessage *message) {
+					valid = (message && dbus_message_iter_init(message,&iter));
+				}
+
+				inline Argument operator*() const {
+					return Argument{iter};
+				}
+
+				inline Iterator & operator++() {
+					valid = dbus_message_iter_next(&iter);
+					return *this;
+				}
+
+				inline bool operator==(const Iterator &other) const noexcept {
+					// Only the end of the arguments can be compared.
+					return valid == other.valid && !valid;
+				}
+
+				inline bool operator!=(const Iterator &other) const noexcept {
+					return !(*this == other);
+				}
+
+			};
+
+			MessageView(DBusMessage *m) noexcept : message{m} {
+			}
+
+			MessageView(const Message &message) noexcept;
+
+			inline operator DBusMessage *() const noexcept {
+				return message;
+			}
+
+			inline Iterator begin() const {
+				return Iterator{message};
+			}
+
+			inline Iterator end() const noexcept {
+				return Iterator{};
+			}
+
+			/// @brief Get argument by position.
+			Argument operator[](size_t index) const;
+
+			/// @brief Get the number of arguments.
+			size_t size() const noexcept;
+
+			inline std::string_view sender() const noexcept {
+				return view(message ? dbus_message_get_sender(message) : nullptr);
+			}
+
+			inline std::string_view destination() const noexcept {
+				return view(message ? dbus_message_get_destination(message) : nullptr);
+			}
+
+			inline std::string_view path() const noexcept {
+				return view(message ? dbus_message_get_path(message) : nullptr);
+			}
+
+			inline std::string_view interface() const noexcept {
+				return view(message ? dbus_message_get_interface(message) : nullptr);
+			}
+
+			inline std::string_view member() const noexcept {
+				return view(message ? dbus_message_get_member(message) : nullptr);
+			}
+
+			inline std::string_view signature() const noexcept {
+				return view(message ? dbus_message_get_signature(message) : nullptr);
+			}
+
+			inline uint32_t serial() const noexcept {
+				return message ? dbus_message_get_serial(message) : 0;
+			}
+
+			/// @brief Read all arguments as typed values.
+			/// @details The message signature is checked once against the compile time signature of the types.
+			template<typename... T>
+			std::tuple<T...> unpack() const {
+
+				const char *expected = DBus::signature<T...>();
+				if(!message || !dbus_message_has_signature(message,expected)) {
+					throw std::runtime_error(std::string{"Unexpected d-bus signature, expecting '"} + expected + "'");
+				}
+
+				DBusMessageIter iter;
+				dbus_message_iter_init(message,&iter);
+
+				std::tuple<T...> values;
+				std::apply([&iter](T&... value){
+					(Marshaller<T>::pop(&iter,value), ...);
+				},values);
+
+				return values;
+			}
+
+		};
+
+ 	}
+
+ }
@@ -0,0 +1,265 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements d-bus agent.
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <dbus/dbus.h>
+ #include <udjat/tools/logger.h>
+ #include <udjat/tools/string.h>
+ #include <udjat/tools/dbus/connection.h>
+ #include <udjat/tools/dbus/message.h>
+ #include <udjat/tools/dbus/value.h>
+ #include <udjat/agent/d-bus.h>
+ #include <string_view>
+ #include <vector>
+ #include <mutex>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	struct DBus::Agent::Link {
+
+		/// @brief Held while the handlers run, stop() waits for them.
+		std::recursive_mutex guard;
+
+		/// @brief The agent, nullptr after stop().
+		DBus::Agent *agent;
+
+		Link(DBus::Agent *a) : agent{a} {
+		}
+
+		/// @brief Update the agent value, if still linked.
+		void set(const DBus::Value &value) {
+			lock_guard<recursive_mutex> lock(guard);
+			if(agent) {
+				agent->set(value);
+			}
+		}
+
+		/// @brief Get the value again, if still linked.
+		void fetch() {
+			lock_guard<recursive_mutex> lock(guard);
+			if(agent) {
+				agent->fetch();
+			}
+		}
+
+	};
+
+	/// @brief Get required attribute.
+	static std::string required(const XML::Node &node, const char *name) {
+		String value{node,name};
+		if(value.empty()) {
+			throw system_error(EINVAL,system_category(),String{"Required attribute <",name,"> is missing or empty"});
+		}
+		return value;
+	}
+
+	DBus::Agent::Agent(const XML::Node &node)
+		: Abstract::Agent(node),
+			destination{required(node,"dbus-destination")},
+			path{required(node,"dbus-path")},
+			iface{required(node,"dbus-interface")},
+			property{required(node,"dbus-property")},
+			dispatch{node} {
+
+		static DBusBusType types[] = {
+			DBUS_BUS_SESSION,
+			DBUS_BUS_SYSTEM,
+			DBUS_BUS_STARTER
+		};
+
+		size_t type = String(node,"dbus-bus-type","starter").select("session","system","starter",NULL);
+
+		if(type >= (sizeof(types)/sizeof(types[0]))) {
+			throw runtime_error("Invalid bus type");
+		}
+
+		connection = Abstract::DBus::Connection::getInstance(types[type]);
+
+	}
+
+	DBus::Agent::~Agent() {
+
+		if(link) {
+			lock_guard<recursive_mutex> lock(link->guard);
+			link->agent = nullptr;
+		}
+
+		if(member) {
+			connection->remove(*member);
+		}
+
+	}
+
+	void DBus::Agent::start() {
+
+		Abstract::Agent::start();
+
+		if(link) {
+			return;
+		}
+
+		link = make_shared<Link>(this);
+
+		// Subscribe before the first Get, so a change between them is not lost.
+		Udjat::DBus::Member::Filter filter;
+		filter.path = path;
+		filter.sender = destination;
+		filter.args.push_back(iface);
+
+		member = &connection->subscribe(
+			DBUS_INTERFACE_PROPERTIES,
+			"PropertiesChanged",
+			filter,
+			dispatch,
+			[link=this->link,property=this->property](Udjat::DBus::Message &message) {
+
+				// The names and the values are read from the message buffer, only the property is copied.
+				Udjat::DBus::Value iface, changed;
+				std::vector<std::string_view> invalidated;
+
+				message.borrow(iface).borrow(changed).pop(invalidated);
+
+				const Udjat::DBus::Value *value = changed.find(property.c_str());
+				if(value) {
+					link->set(*value);
+					return;
+				}
+
+				for(std::string_view name : invalidated) {
+					if(name == property) {
+						// Changed without the new value, get it.
+						link->fetch();
+						return;
+					}
+				}
+
+			}
+		);
+
+		fetch();
+
+	}
+
+	void DBus::Agent::stop() {
+
+		if(link) {
+
+			// Wait for the running handlers and unlink.
+			{
+				lock_guard<recursive_mutex> lock(link->guard);
+				link->agent = nullptr;
+			}
+
+			link.reset();
+
+		}
+
+		if(member) {
+			connection->remove(*member);
+			member = nullptr;
+		}
+
+		Abstract::Agent::stop();
+
+	}
+
+	bool DBus::Agent::refresh() {
+		return false;
+	}
+
+	void DBus::Agent::fetch() {
+
+		Udjat::DBus::Message request{
+			destination.c_str(),
+			path.c_str(),
+			DBUS_INTERFACE_PROPERTIES,
+			"Get",
+			iface.c_str(),
+			property.c_str()
+		};
+
+		connection->call(request,[link=this->link,name=std::string{name()}](Udjat::DBus::Message &response) {
+
+			if(!response) {
+				Logger::String{"Can't get d-bus property: ",response.error_message()}.warning(name.c_str());
+				return;
+			}
+
+			Udjat::DBus::Value value;
+			response.pop(value);
+			link->set(value);
+
+		});
+
+	}
+
+	void DBus::Agent::set(const Udjat::DBus::Value &value) {
+
+		{
+			lock_guard<mutex> lock(guard);
+			this->value = value;
+		}
+
+		updated(true);
+
+	}
+
+	std::string DBus::Agent::to_string() const noexcept {
+
+		std::string str;
+
+		try {
+
+			lock_guard<mutex> lock(guard);
+			if(!value.isNull()) {
+				value.get(str);
+			}
+
+		} catch(const std::exception &e) {
+
+			Logger::String{e.what()}.error(name());
+
+		}
+
+		return str;
+
+	}
+
+	Udjat::Value & DBus::Agent::get(Udjat::Value &value) const {
+
+		lock_guard<mutex> lock(guard);
+
+		if(this->value.isNull()) {
+			value.reset(Udjat::Value::Undefined);
+		} else {
+			this->value.get(value);
+		}
+
+		return value;
+
+	}
+
+ }
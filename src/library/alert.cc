@@ -26,6 +26,7 @@
  #include <udjat/tools/string.h>
  #include <udjat/tools/dbus/signal.h>
  #include <string>
+ #include <mutex>
  #include <udjat/alert/d-bus.h>
 
  using namespace std;
@@ -126,7 +127,21 @@
 
 	}
 
-	DBus::Alert::Alert(const Abstract::Object &parent, const pugi::xml_node &node) : Abstract::Alert(node) {
+	struct DBus::Alert::Prototype {
+		std::mutex guard;
+		std::shared_ptr<const DBus::SignalTemplate> signal;
+
+		/// @brief Get template for the names, rebuild it only when they change.
+		std::shared_ptr<const DBus::SignalTemplate> get(const char *iface, const char *member, const char *path) {
+			lock_guard<mutex> lock(guard);
+			if(!(signal && signal->matches(iface,member,path))) {
+				signal = make_shared<DBus::SignalTemplate>(iface,member,path);
+			}
+			return signal;
+		}
+	};
+
+	DBus::Alert::Alert(const Abstract::Object &parent, const pugi::xml_node &node) : Abstract::Alert(node), prototype{make_shared<Prototype>()} {
 
 		const char *group = node.attribute("settings-from").as_string("alert-defaults");
 
@@ -181,6 +196,7 @@
 			String iface;
 			String member;
 			DBusBusType bustype;
+			std::shared_ptr<Alert::Prototype> prototype;
 
 			std::vector<Alert::Argument> arguments;
 
@@ -189,9 +205,11 @@
 			void emit() override {
 
 				DBus::Signal signal{
-					iface.expand(true,true).c_str(),
-					member.expand(true,true).c_str(),
-					path.expand(true,true).c_str()
+					*prototype->get(
+						iface.expand(true,true).c_str(),
+						member.expand(true,true).c_str(),
+						path.expand(true,true).c_str()
+					)
 				};
 
 				debug("---> Emitting D-Bus alert ",iface.c_str()," ",member.c_str(),"/",path.c_str());
@@ -246,27 +264,16 @@
 					debug("Argument: ",argument.value);
 				}
 
-				switch(bustype) {
-				case DBUS_BUS_SESSION:
-					signal.session();
-					break;
-
-				case DBUS_BUS_SYSTEM:
-					signal.system();
-					break;
-
-				case DBUS_BUS_STARTER:
-					signal.starter();
-					break;
-
-				default:
-					throw system_error(EINVAL,system_category(), "Invalid bus type");
+				// Emit using the shared bus connection, without waiting for the socket.
+				// The drop is a queue policy, not an alert failure; retrying would refill the queue.
+				if(!signal.enqueue(*Abstract::DBus::Connection::getInstance(bustype))) {
+					Logger::String{"Outgoing d-bus queue is full, signal ",iface.c_str(),".",member.c_str()," was dropped"}.warning("d-bus");
 				}
 
 			}
 
 		public:
-			Activation(const DBus::Alert *alert) : Udjat::Alert::Activation(alert), path(alert->path), iface(alert->iface), member(alert->member), bustype(alert->bus()) {
+			Activation(const DBus::Alert *alert) : Udjat::Alert::Activation(alert), path(alert->path), iface(alert->iface), member(alert->member), bustype(alert->bus()), prototype(alert->prototype) {
 
 				for(const Alert::Argument &argument : alert->args()) {
 					arguments.push_back(argument);
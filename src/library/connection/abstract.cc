@@ -26,6 +26,7 @@
  #include <dbus/dbus.h>
  #include <string>
  #include <mutex>
+ #include <shared_mutex>
  #include <udjat/tools/dbus/connection.h>
  #include <udjat/tools/dbus/interface.h>
  #include <udjat/tools/dbus/message.h>
@@ -33,6 +34,8 @@
  #include <udjat/tools/logger.h>
  #include <udjat/tools/mainloop.h>
  #include <private/mainloop.h>
+ #include <private/server.h>
+ #include <private/owner.h>
  #include <udjat/tools/string.h>
 
  using namespace std;
@@ -64,8 +67,6 @@
 
 	};
 
-	std::mutex Abstract::DBus::Connection::guard;
-
 	static void trace_connection_free(const Abstract::DBus::Connection *connection) {
 		Logger::String("Connection '",((unsigned long) connection),"' was released").trace("d-bus");
 	}
@@ -106,7 +107,7 @@
 
 	void Abstract::DBus::Connection::open() {
 
-		lock_guard<mutex> lock(guard);
+		lock_guard<shared_mutex> lock(guard);
 
 		// Keep running if d-bus disconnect.
 		dbus_connection_set_exit_on_disconnect(conn, false);
@@ -119,6 +120,34 @@
 		// Initialize Main loop.
 		MainLoop::getInstance();
 
+		bind();
+
+		// Set dispatch function, for the messages left by the dispatch budget.
+		dispatcher = new Dispatcher(*this);
+		dbus_connection_set_dispatch_status_function(
+			conn,
+			(DBusDispatchStatusFunction) handle_dispatch_status,
+			this,
+			nullptr
+		);
+
+		if(Logger::enabled(Logger::Trace)) {
+
+			dbus_connection_set_data(conn,DataSlot::getInstance().value(),this,(DBusFreeFunction) trace_connection_free);
+
+			int fd = -1;
+			if(dbus_connection_get_socket(conn,&fd)) {
+				Logger::String("Allocating connection '",((unsigned long) this),"' with socket '",fd,"'").trace(name());
+			} else {
+				Logger::String("Allocating connection '",((unsigned long) this),"'").trace(name());
+			}
+
+		}
+
+	}
+
+	void Abstract::DBus::Connection::bind() {
+
 		// Set watch functions.
 		if(!dbus_connection_set_watch_functions(
 			conn,
@@ -143,20 +172,6 @@
 			throw runtime_error("dbus_connection_set_timeout_functions has failed");
 		}
 
-
-		if(Logger::enabled(Logger::Trace)) {
-
-			dbus_connection_set_data(conn,DataSlot::getInstance().value(),this,(DBusFreeFunction) trace_connection_free);
-
-			int fd = -1;
-			if(dbus_connection_get_socket(conn,&fd)) {
-				Logger::String("Allocating connection '",((unsigned long) this),"' with socket '",fd,"'").trace(name());
-			} else {
-				Logger::String("Allocating connection '",((unsigned long) this),"'").trace(name());
-			}
-
-		}
-
 	}
 
 	void Abstract::DBus::Connection::bus_register() {
@@ -175,7 +190,11 @@
 
 	void Abstract::DBus::Connection::close() {
 
-		lock_guard<mutex> lock(guard);
+		if(service) {
+			stop_thread();
+		}
+
+		lock_guard<shared_mutex> lock(guard);
 
         if(Logger::enabled(Logger::Trace)) {
 			int fd = -1;
@@ -188,15 +207,38 @@
 
 		flush();
 
-		// Remove interfaces.
-		interfaces.remove_if([this](Udjat::DBus::Interface &intf) {
-			remove(intf);
-			return true;
-		});
+		// Remove match rules and interfaces.
+		for(const auto &rule : rules) {
+			Logger::String{"Disconnecting from '",rule.first.c_str(),"'"}.trace(name());
+			dbus_bus_remove_match(conn,rule.first.c_str(),NULL);
+		}
+		rules.clear();
+		routes.reset();
+		owners.clear();
+		for(const auto &intf : interfaces) {
+			for(const auto &member : intf) {
+				member.active.store(false,std::memory_order_release);
+			}
+		}
+		retired.interfaces.splice(retired.interfaces.end(),interfaces);
+		retired.pending = true;
+		purge();
+
+		// Remove exported methods, calls in progress keep their own reference.
+		if(server) {
+			delete server;
+			server = nullptr;
+		}
 
 		// Remove filter
 		dbus_connection_remove_filter(conn,(DBusHandleMessageFunction) filter, this);
 
+		dbus_connection_set_dispatch_status_function(conn,(DBusDispatchStatusFunction) NULL,NULL,nullptr);
+		if(dispatcher) {
+			delete dispatcher;
+			dispatcher = nullptr;
+		}
+
 		Logger::String{"Restoring d-bus watchers"}.trace(name());
 
 		if(!dbus_connection_set_watch_functions(
@@ -227,49 +269,64 @@
 
 		debug(__FUNCTION__);
 
-		if(dbus_message_get_type(message) == DBUS_MESSAGE_TYPE_SIGNAL) {
+		switch(dbus_message_get_type(message)) {
+		case DBUS_MESSAGE_TYPE_SIGNAL:
 			return connection->on_signal(message);
-		}
 
-		// TODO: Filter method calls.
+		case DBUS_MESSAGE_TYPE_METHOD_CALL:
+			return connection->on_method(message);
+
+		}
 
 		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 	}
 
 	DBusHandlerResult Abstract::DBus::Connection::on_signal(DBusMessage *message) noexcept {
 
-		lock_guard<mutex> lock(guard);
-
 		const char *interface = dbus_message_get_interface(message);
 		const char *member = dbus_message_get_member(message);
 
+		if(!(interface && member)) {
+			return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+		}
+
 		if(Logger::enabled(Logger::Trace)) {
 			Logger::String{"Signal ", interface," ",member}.trace(name());
 		}
 
-		for(const auto &intf : interfaces) {
+		// Get the routing table, the callbacks can change the subscriptions
+		// then the dispatch cant hold the guard.
+		std::shared_ptr<const Routes> table;
+		{
+			shared_lock<shared_mutex> lock(guard);
+			table = routes;
+			dispatching++;
+		}
 
-			if(intf == interface) {
+		if(table) {
 
-				for(const auto &imemb : intf) {
+			auto bucket = table->find(Udjat::DBus::hash(Udjat::DBus::hash(interface),Udjat::DBus::hash(member)));
+			if(bucket != table->end()) {
 
-					if(imemb == member) {
+				for(const Route &route : bucket->second) {
 
-						try {
+					// Check names, the hash can collide; skip members removed by a previous callback.
+					if(!(route.member->subscribed() && *route.interface == interface && *route.member == member && route.member->matches(message))) {
+						continue;
+					}
 
-							debug("Processing ",interface,".",member);
-							Udjat::DBus::Message msg(message);
-							imemb.call(msg);
+					try {
 
-						} catch(const std::exception &e) {
+						debug("Processing ",interface,".",member);
+						route.member->call(message);
 
-							Logger::String{interface,".",member,": ",e.what()}.error(name());
+					} catch(const std::exception &e) {
 
-						} catch(...) {
+						Logger::String{interface,".",member,": ",e.what()}.error(name());
 
-							Logger::String{interface,".",member,": Unexpecter error"}.error(name());
+					} catch(...) {
 
-						}
+						Logger::String{interface,".",member,": Unexpecter error"}.error(name());
 
 					}
 
@@ -279,71 +336,293 @@
 
 		}
 
+		if(--dispatching == 0 && retired.pending) {
+			lock_guard<shared_mutex> lock(guard);
+			purge();
+		}
+
 		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 
 	}
 
+	void Abstract::DBus::Connection::reindex() {
+
+		auto table = make_shared<Routes>();
+
+		for(const auto &intf : interfaces) {
+			for(const auto &memb : intf) {
+				(*table)[Udjat::DBus::hash(intf.hash(),memb.hash())].push_back(Route{&intf,&memb});
+			}
+		}
+
+		routes = table;
+
+	}
+
+	void Abstract::DBus::Connection::purge() noexcept {
+
+		// The dispatch count is incremented with the guard locked, no new dispatch can start now.
+		if(dispatching || !retired.pending) {
+			return;
+		}
+
+		retired.members.clear();
+		retired.interfaces.clear();
+		retired.pending = false;
+
+	}
+
 	void Abstract::DBus::Connection::flush() noexcept {
 		dbus_connection_flush(conn);
 	}
 
-	void Abstract::DBus::Connection::insert(const Udjat::DBus::Interface &interface) {
+	/// @brief Build a method call to the bus daemon with the match rule as argument.
+	static DBusMessage * MatchFactory(const char *method, const std::string &rule) {
 
-		Logger::String{"Connecting to '",interface.rule().c_str(),"'"}.trace(name());
+		DBusMessage *message = dbus_message_new_method_call(DBUS_SERVICE_DBUS,DBUS_PATH_DBUS,DBUS_INTERFACE_DBUS,method);
+		if(!message) {
+			throw runtime_error("Cant create match rule message");
+		}
 
-		DBusError error;
-		dbus_error_init(&error);
+		DBusMessageIter iter;
+		dbus_message_iter_init_append(message, &iter);
 
-		dbus_bus_add_match(conn,interface.rule().c_str(), &error);
-		dbus_connection_flush(conn);
+		const char *str = rule.c_str();
+		if(!dbus_message_iter_append_basic(&iter,DBUS_TYPE_STRING,&str)) {
+			dbus_message_unref(message);
+			throw runtime_error("Cant add match rule to message");
+		}
+
+		return message;
+
+	}
+
+	std::function<void(const char *rule, const char *message)> Abstract::DBus::Connection::failed() const {
+		std::string name{object_name};
+		return [name](const char *rule, const char *message) {
+			Logger::String{"Error '",message,"' adding match rule '",rule,"'"}.error(name.c_str());
+		};
+	}
+
+	void Abstract::DBus::Connection::add_match(const std::string &rule, const std::function<void(const char *rule, const char *message)> &failed) {
+
+		size_t &count = rules[rule];
+		if(count++) {
+			return;
+		}
+
+		Logger::String{"Connecting to '",rule.c_str(),"'"}.trace(name());
+
+		// Send as a pending call, the bus will get all rules in sequence without waiting for replies.
+		DBusMessage *message = nullptr;
+
+		try {
+
+			message = MatchFactory("AddMatch",rule);
+
+			call(message,[rule,failed](Udjat::DBus::Message &reply){
+				if(reply.failed()) {
+					failed(rule.c_str(),reply.error_message());
+				}
+			});
+
+		} catch(...) {
+
+			if(message) {
+				dbus_message_unref(message);
+			}
+			rules.erase(rule);
+			throw;
+
+		}
+
+		dbus_message_unref(message);
+
+	}
+
+	void Abstract::DBus::Connection::remove_match(const std::string &rule) noexcept {
+
+		auto it = rules.find(rule);
+		if(it == rules.end()) {
+			return;
+		}
+
+		if(--it->second) {
+			return;
+		}
+
+		rules.erase(it);
+
+		Logger::String{"Disconnecting from '",rule.c_str(),"'"}.trace(name());
+
+		try {
+
+			DBusMessage *message = MatchFactory("RemoveMatch",rule);
+
+			std::string name{object_name};
+			try {
+				call(message,[rule,name](Udjat::DBus::Message &reply){
+					if(reply.failed()) {
+						Logger::String{"Error '",reply.error_message(),"' removing match rule '",rule.c_str(),"'"}.error(name.c_str());
+					}
+				});
+			} catch(...) {
+				dbus_message_unref(message);
+				throw;
+			}
+
+			dbus_message_unref(message);
+
+		} catch(const std::exception &e) {
+
+			Logger::String{"Error '",e.what(),"' removing match rule '",rule.c_str(),"'"}.error(name());
 
-		if (dbus_error_is_set(&error)) {
-			Logger::String message{"Error '",error.message,"' adding interface"};
-			dbus_error_free(&error);
-			throw std::runtime_error(message);
 		}
 
 	}
 
-	void Abstract::DBus::Connection::remove(const Udjat::DBus::Interface &interface) {
+	std::shared_ptr<Udjat::DBus::Member::Owner> Abstract::DBus::Connection::owner(const std::string &bus_name) {
+
+		auto it = owners.find(bus_name);
+		if(it != owners.end()) {
+			return it->second;
+		}
+
+		auto owner = make_shared<Udjat::DBus::Member::Owner>(bus_name.c_str());
+
+		// Watch the changes before asking, the serials order the signal and the reply.
+		Udjat::DBus::Member::Filter filter;
+		filter.sender = DBUS_SERVICE_DBUS;
+		filter.path = DBUS_PATH_DBUS;
+		filter.args.push_back(bus_name);
+
+		Udjat::DBus::Interface &intf = find_interface(DBUS_INTERFACE_DBUS);
+		activate(
+			intf,
+			intf.members.emplace_back("NameOwnerChanged",filter,[owner](Udjat::DBus::Message &message){
+
+				const char *name = nullptr, *from = nullptr, *to = nullptr;
+				if(dbus_message_get_args((DBusMessage *) message,NULL,DBUS_TYPE_STRING,&name,DBUS_TYPE_STRING,&from,DBUS_TYPE_STRING,&to,DBUS_TYPE_INVALID)) {
+					owner->set(to,dbus_message_get_serial((DBusMessage *) message));
+				}
+
+			}),
+			failed()
+		);
+
+		DBusMessage *message = dbus_message_new_method_call(DBUS_SERVICE_DBUS,DBUS_PATH_DBUS,DBUS_INTERFACE_DBUS,"GetNameOwner");
+		if(!message) {
+			throw runtime_error("Cant create GetNameOwner message");
+		}
+
+		try {
+
+			const char *str = bus_name.c_str();
+			if(!dbus_message_append_args(message,DBUS_TYPE_STRING,&str,DBUS_TYPE_INVALID)) {
+				throw runtime_error("Cant add bus name to message");
+			}
+
+			call(message,[owner](Udjat::DBus::Message &reply){
+
+				if(reply.failed()) {
+					if(!strcmp(reply.error_name(),DBUS_ERROR_NAME_HAS_NO_OWNER)) {
+						owner->set("",0);
+					}
+					return;
+				}
+
+				const char *unique = nullptr;
+				if(dbus_message_get_args((DBusMessage *) reply,NULL,DBUS_TYPE_STRING,&unique,DBUS_TYPE_INVALID)) {
+					owner->set(unique,dbus_message_get_serial((DBusMessage *) reply));
+				}
+
+			});
+
+		} catch(...) {
+
+			dbus_message_unref(message);
+			throw;
+
+		}
 
-		Logger::String{"Disconnecting from '",interface.rule().c_str(),"'"}.trace(name());
+		dbus_message_unref(message);
 
-		DBusError error;
-		dbus_error_init(&error);
+		owners[bus_name] = owner;
+		return owner;
 
-		dbus_bus_remove_match(conn,interface.rule().c_str(), &error);
+	}
+
+	void Abstract::DBus::Connection::watch(Udjat::DBus::Interface &intf) {
 
-		if(dbus_error_is_set(&error)) {
-			Logger::String{"Error '",error.message,"' removing interface '",interface.c_str(),"'"}.error(name());
-			dbus_error_free(&error);
+		if(intf.connection) {
+			return;
 		}
 
+		add_match(intf.rule(),failed());
+		intf.connection = this;
+		reindex();
+
+	}
+
+	Udjat::DBus::Member & Abstract::DBus::Connection::insert(const std::function<Udjat::DBus::Member &()> &emplace) {
+
+		lock_guard<shared_mutex> lock(guard);
+
+		// The interface-wide rule is already on the bus, just route the new member.
+		Udjat::DBus::Member &member = emplace();
+		track(member);
+		reindex();
+		return member;
+
 	}
 
 	void Abstract::DBus::Connection::push_back(Udjat::DBus::Interface &intf) {
-		lock_guard<mutex> lock(guard);
-		insert(intf);
+
+		lock_guard<shared_mutex> lock(guard);
+
 		interfaces.push_back(intf);
+		interfaces.back().connection = nullptr;
+
+		try {
+			watch(interfaces.back());
+		} catch(...) {
+			interfaces.pop_back();
+			throw;
+		}
+
 	}
 
-	Udjat::DBus::Interface & Abstract::DBus::Connection::emplace_back(const char *intf) {
+	Udjat::DBus::Interface & Abstract::DBus::Connection::find_interface(const char *intf) {
 
 		if(!(intf && *intf)) {
 			throw system_error(EINVAL,system_category(),"A dbus interface name is required");
 		}
 
-		lock_guard<mutex> lock(guard);
-
 		for(auto &inserted : interfaces) {
-			if(!strcasecmp(inserted.c_str(),intf)) {
+			if(inserted == intf) {
 				Logger::String{"Already watching '",intf,"'"}.trace(name());
 				return inserted;
 			}
 		}
 
-		Udjat::DBus::Interface & interface = interfaces.emplace_back(intf);
-		insert(interface);
+		return interfaces.emplace_back(intf);
+	}
+
+	Udjat::DBus::Interface & Abstract::DBus::Connection::emplace_back(const char *intf) {
+
+		lock_guard<shared_mutex> lock(guard);
+		Udjat::DBus::Interface &interface = find_interface(intf);
+
+		try {
+			watch(interface);
+		} catch(...) {
+			if(interface.empty()) {
+				interfaces.remove_if([&interface](const Udjat::DBus::Interface &i){
+					return &i == &interface;
+				});
+			}
+			throw;
+		}
 
 		return interface;
 	}
@@ -354,37 +633,286 @@
 	}
 
 	Udjat::DBus::Member & Abstract::DBus::Connection::subscribe(const char *interface, const char *member, const std::function<void(Udjat::DBus::Message &message)> &callback) {
-		return emplace_back(interface).emplace_back(member,callback);
+		return subscribe(interface,member,Udjat::DBus::Member::Filter{},callback);
+	}
+
+	Abstract::DBus::Connection::Subscription::Subscription(const char *i, const char *m, const std::function<void(Udjat::DBus::Message &message)> &c)
+		: interface{i}, member{m}, callback{c} {
+	}
+
+	Abstract::DBus::Connection::Subscription::Subscription(const char *i, const char *m, const Udjat::DBus::Member::Filter &f, const std::function<void(Udjat::DBus::Message &message)> &c)
+		: interface{i}, member{m}, filter{f}, callback{c} {
+	}
+
+	Abstract::DBus::Connection::Subscription::Subscription(const char *i, const char *m, const Udjat::DBus::Member::Filter &f, const Udjat::DBus::Member::Dispatch &d, const std::function<void(Udjat::DBus::Message &message)> &c)
+		: interface{i}, member{m}, filter{f}, dispatch{d}, callback{c} {
+	}
+
+	Abstract::DBus::Connection::Subscription::Subscription(const XML::Node &node, const std::function<void(Udjat::DBus::Message &message)> &c)
+		: interface{String{node,"dbus-interface"}}, member{String{node,"dbus-member"}}, filter{node}, dispatch{node}, callback{c} {
+	}
+
+	Udjat::DBus::Member & Abstract::DBus::Connection::activate(Udjat::DBus::Interface &intf, Udjat::DBus::Member &member, const std::function<void(const char *rule, const char *message)> &failed) {
+
+		try {
+
+			add_match(member.rule(intf.c_str()),failed);
+			member.matched = true;
+
+		} catch(...) {
+
+			// Undo the insertion.
+			intf.remove(member);
+			if(intf.empty() && !intf.connection) {
+				interfaces.remove_if([&intf](const Udjat::DBus::Interface &i){
+					return &i == &intf;
+				});
+			}
+			throw;
+
+		}
+
+		track(member);
+		return member;
+
+	}
+
+	void Abstract::DBus::Connection::track(Udjat::DBus::Member &member) noexcept {
+
+		// Unique names and the bus daemon don't change owner.
+		const std::string &sender = member.filter.sender;
+		if(sender.empty() || sender[0] == ':' || sender == DBUS_SERVICE_DBUS) {
+			return;
+		}
+
+		try {
+
+			member.owner = owner(sender);
+
+		} catch(const std::exception &e) {
+
+			// Without the owner the sender is not checked locally.
+			Logger::String{"Can't track owner of '",sender.c_str(),"': ",e.what()}.warning(name());
+
+		}
+
+	}
+
+	Udjat::DBus::Member & Abstract::DBus::Connection::subscribe(const char *interface, const char *member, const Udjat::DBus::Member::Filter &filter, const std::function<void(Udjat::DBus::Message &message)> &callback) {
+		return subscribe(interface,member,filter,Udjat::DBus::Member::Dispatch{},callback);
+	}
+
+	Udjat::DBus::Member & Abstract::DBus::Connection::subscribe(const char *interface, const char *member, const Udjat::DBus::Member::Filter &filter, const Udjat::DBus::Member::Dispatch &dispatch, const std::function<void(Udjat::DBus::Message &message)> &callback) {
+
+		lock_guard<shared_mutex> lock(guard);
+
+		Udjat::DBus::Interface &intf = find_interface(interface);
+		Udjat::DBus::Member &rc = activate(intf,intf.members.emplace_back(member,filter,dispatch,callback),failed());
+
+		reindex();
+		return rc;
+
+	}
+
+	Udjat::DBus::Member & Abstract::DBus::Connection::subscribe(const XML::Node &node, const std::function<void(Udjat::DBus::Message &message)> &callback) {
+
+		lock_guard<shared_mutex> lock(guard);
+
+		Udjat::DBus::Interface &intf = find_interface(String{node,"dbus-interface"}.c_str());
+		Udjat::DBus::Member &rc = activate(intf,intf.members.emplace_back(node,callback),failed());
+
+		reindex();
+		return rc;
+
+	}
+
+	std::vector<Udjat::DBus::Member *> Abstract::DBus::Connection::subscribe(const std::vector<Subscription> &subscriptions, const std::function<void(const char *rule, const char *message)> &failed) {
+
+		std::vector<Udjat::DBus::Member *> members;
+		members.reserve(subscriptions.size());
+
+		lock_guard<shared_mutex> lock(guard);
+
+		try {
+
+			for(const Subscription &subscription : subscriptions) {
+				Udjat::DBus::Interface &intf = find_interface(subscription.interface.c_str());
+				members.push_back(
+					&activate(
+						intf,
+						intf.members.emplace_back(subscription.member.c_str(),subscription.filter,subscription.dispatch,subscription.callback),
+						failed
+					)
+				);
+			}
+
+		} catch(...) {
+
+			reindex();
+			throw;
+
+		}
+
+		reindex();
+		return members;
+
+	}
+
+	std::vector<Udjat::DBus::Member *> Abstract::DBus::Connection::subscribe(const XML::Node &node, const char *tagname, const std::function<void(Udjat::DBus::Message &message)> &callback) {
+
+		std::vector<Subscription> subscriptions;
+		for(XML::Node child = node.child(tagname); child; child = child.next_sibling(tagname)) {
+			subscriptions.emplace_back(child,callback);
+		}
+
+		return subscribe(subscriptions,failed());
+
 	}
 
 	void Abstract::DBus::Connection::remove(const Udjat::DBus::Member &member) {
 
-		lock_guard<mutex> lock(guard);
-		interfaces.remove_if([this,&member](Udjat::DBus::Interface &interface){
+		lock_guard<shared_mutex> lock(guard);
 
-			interface.remove(member);
+		for(auto interface = interfaces.begin(); interface != interfaces.end(); interface++) {
 
-			if(interface.empty()) {
-				remove(interface);
-				return true;
+			if(!interface->contains(member)) {
+				continue;
 			}
 
-			return false;
+			// Keep the member and the interface alive until the dispatches using them finish.
+			member.active.store(false,std::memory_order_release);
+			if(member.matched) {
+				remove_match(member.rule(interface->c_str()));
+			}
+			interface->splice(member,retired.members);
+
+			if(interface->empty()) {
+				if(interface->connection) {
+					remove_match(interface->rule());
+				}
+				retired.interfaces.splice(retired.interfaces.end(),interfaces,interface);
+			}
+
+			retired.pending = true;
+			reindex();
+			purge();
+			return;
+
+		}
+
+	}
+
+	void Abstract::DBus::Connection::send(DBusMessage *message) {
+
+		// A message sent before has the serial from the other connection.
+		if(dbus_message_get_serial(message)) {
 
-		});
+			DBusMessage *copy = dbus_message_copy(message);
+			if(!copy) {
+				throw runtime_error("Can't copy D-Bus signal");
+			}
+
+			dbus_bool_t rc = dbus_connection_send(conn, copy, NULL);
+			dbus_message_unref(copy);
+
+			if(!rc) {
+				throw runtime_error("Can't send D-Bus signal");
+			}
+
+			return;
+		}
+
+		if(!dbus_connection_send(conn, message, NULL)) {
+			throw runtime_error("Can't send D-Bus signal");
+		}
 
 	}
 
 	void Abstract::DBus::Connection::signal(const Udjat::DBus::Signal &sig) {
 
-		lock_guard<mutex> lock(guard);
+		// No need to lock, libdbus serializes the connection access by itself.
+		send(sig.dbus_message());
+		dbus_connection_flush(conn);
+
+	}
 
-		dbus_bool_t rc = dbus_connection_send(conn, sig.dbus_message(), NULL);
+	void Abstract::DBus::Connection::signal(const Udjat::DBus::SignalBatch &batch) {
+
+		for(DBusMessage *message : batch) {
+			send(message);
+		}
 		dbus_connection_flush(conn);
 
-		if(!rc) {
-			throw runtime_error("Can't send D-Bus signal");
+	}
+
+	size_t Abstract::DBus::Connection::outgoing() const noexcept {
+		return (size_t) dbus_connection_get_outgoing_size(conn);
+	}
+
+	void Abstract::DBus::Connection::set_outgoing_limits(size_t high, size_t low, OutgoingPolicy policy) {
+
+		if(low > high) {
+			throw system_error(EINVAL,system_category(),"The low watermark must not exceed the high one");
+		}
+
+		watermarks.high = high;
+		watermarks.low = low;
+		watermarks.policy = policy;
+
+	}
+
+	bool Abstract::DBus::Connection::admit() {
+
+		size_t size = outgoing();
+
+		if(size >= watermarks.high || (watermarks.over && size > watermarks.low)) {
+
+			if(watermarks.policy == Drop) {
+
+				if(!watermarks.over.exchange(true)) {
+					Logger::String{"Outgoing queue is over ",watermarks.high," bytes, dropping signals"}.warning(name());
+				}
+
+				watermarks.dropped++;
+				return false;
+
+			}
+
+			// Block policy, wait for the socket to drain.
+			dbus_connection_flush(conn);
+
+		}
+
+		if(watermarks.over.exchange(false)) {
+			Logger::String{"Outgoing queue drained, ",watermarks.dropped.exchange(0)," signal(s) were dropped"}.warning(name());
+		}
+
+		return true;
+
+	}
+
+	bool Abstract::DBus::Connection::enqueue(const Udjat::DBus::Signal &sig) {
+
+		if(!admit()) {
+			return false;
+		}
+
+		// Without flush; libdbus writes what it can now and enables the writable watch for the rest.
+		send(sig.dbus_message());
+		return true;
+
+	}
+
+	bool Abstract::DBus::Connection::enqueue(const Udjat::DBus::SignalBatch &batch) {
+
+		if(!admit()) {
+			return false;
+		}
+
+		for(DBusMessage *message : batch) {
+			send(message);
 		}
+		return true;
 
 	}
 
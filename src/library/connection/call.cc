@@ -240,9 +240,9 @@
 		dbus_pending_call_set_data(pending,slot,parameters,(DBusFreeFunction) free_parameters);
 
 		if(!dbus_pending_call_set_notify(pending, (DBusPendingCallNotifyFunction) dbus_call_reply, (void *) parameters, NULL)) {
+			// The message belongs to the caller; the parameters are released with the pending call data.
+			dbus_pending_call_cancel(pending);
 			dbus_pending_call_unref(pending);
-			dbus_message_unref(message);
-			delete parameters;
 			throw std::runtime_error("Can't set call notify function");
 		}
 
@@ -0,0 +1,176 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2015 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the bounded message dispatch.
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <private/mainloop.h>
+ #include <udjat/tools/mainloop.h>
+ #include <udjat/tools/handler.h>
+ #include <udjat/tools/logger.h>
+ #include <sys/eventfd.h>
+ #include <unistd.h>
+ #include <chrono>
+ #include <system_error>
+
+/*---[ Implement ]----------------------------------------------------------------------------------*/
+
+ void handle_dispatch_status(DBusConnection *, DBusDispatchStatus status, Abstract::DBus::Connection *connection) {
+
+	// Called by libdbus, can't dispatch from here; let the main loop do it.
+	if(status == DBUS_DISPATCH_DATA_REMAINS) {
+		connection->wakeup();
+	}
+
+ }
+
+ Abstract::DBus::Connection::Dispatcher::Dispatcher(Abstract::DBus::Connection &c) : connection{c}, efd{eventfd(0,EFD_NONBLOCK|EFD_CLOEXEC)} {
+
+	if(efd < 0) {
+		throw system_error(errno,system_category(),"Cant create d-bus dispatcher");
+	}
+
+	set(efd);
+	enable();
+
+ }
+
+ Abstract::DBus::Connection::Dispatcher::~Dispatcher() {
+	disable();
+	::close(efd);
+ }
+
+ void Abstract::DBus::Connection::Dispatcher::wakeup() noexcept {
+
+	if(pending.exchange(true)) {
+		return;
+	}
+
+	uint64_t value = 1;
+	if(write(efd,&value,sizeof(value)) != sizeof(value)) {
+		pending = false;
+		Logger::String{"Cant signal d-bus dispatcher: ",strerror(errno)}.error(connection.name());
+	}
+
+ }
+
+ void Abstract::DBus::Connection::Dispatcher::handle_event(const Event) {
+
+	uint64_t value;
+	if(read(efd,&value,sizeof(value)) < 0 && errno != EAGAIN) {
+		Logger::String{"Cant read d-bus dispatcher: ",strerror(errno)}.error(connection.name());
+	}
+
+	pending = false;
+
+	std::deque<std::function<void()>> methods;
+	{
+		lock_guard<mutex> lock(guard);
+		methods.swap(tasks);
+	}
+
+	for(auto &method : methods) {
+		try {
+			method();
+		} catch(const std::exception &e) {
+			Logger::String{e.what()}.error(connection.name());
+		} catch(...) {
+			Logger::String{"Unexpected error on posted method"}.error(connection.name());
+		}
+	}
+
+	// With a dedicated thread the dispatch happens there.
+	if(!connection.service.load() && connection.dispatch()) {
+		wakeup();
+	}
+
+ }
+
+ void Abstract::DBus::Connection::Dispatcher::post(const std::function<void()> &method) {
+	{
+		lock_guard<mutex> lock(guard);
+		tasks.push_back(method);
+	}
+	wakeup();
+ }
+
+ void Abstract::DBus::Connection::set_dispatch_budget(unsigned int messages, unsigned int milliseconds) noexcept {
+	budget.messages = messages;
+	budget.milliseconds = milliseconds;
+ }
+
+ void Abstract::DBus::Connection::wakeup() noexcept {
+
+	// Called from any thread, stop_thread() waits for the count before deleting the service.
+	waking++;
+
+	Service *current = service.load();
+	if(current) {
+		current->wakeup();
+	} else if(dispatcher) {
+		dispatcher->wakeup();
+	}
+
+	waking--;
+
+ }
+
+ void Abstract::DBus::Connection::post(const std::function<void()> &method) {
+	if(!dispatcher) {
+		throw logic_error("The connection is not open");
+	}
+	dispatcher->post(method);
+ }
+
+ bool Abstract::DBus::Connection::dispatch() noexcept {
+
+	auto start = std::chrono::steady_clock::now();
+	unsigned int count = 0;
+	bool remains = false;
+
+	// A callback can close the connection, don't use it after the first message.
+	DBusConnection *connection = conn;
+	auto limits = budget;
+
+	dbus_connection_ref(connection);
+	while(dbus_connection_get_dispatch_status(connection) == DBUS_DISPATCH_DATA_REMAINS) {
+
+		if(count && limits.messages && count >= limits.messages) {
+			remains = true;
+			break;
+		}
+
+		if(count && limits.milliseconds && std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(limits.milliseconds)) {
+			remains = true;
+			break;
+		}
+
+		dbus_connection_dispatch(connection);
+		count++;
+
+	}
+	dbus_connection_unref(connection);
+
+	return remains;
+
+ }
+
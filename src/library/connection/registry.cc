@@ -0,0 +1,140 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the registry of shared bus connections.
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <dbus/dbus.h>
+ #include <udjat/tools/dbus/connection.h>
+ #include <udjat/tools/logger.h>
+ #include <udjat/tools/mainloop.h>
+ #include <memory>
+ #include <mutex>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	/// @brief Process-wide registry of the long-lived bus connections.
+	class Registry {
+	private:
+		std::mutex guard;
+
+		/// @brief Shared connections, indexed by bus type.
+		std::shared_ptr<Abstract::DBus::Connection> connections[3];
+
+		Registry() {
+			// The connections are attached to the main loop, make sure it
+			// is constructed first so it will be destroyed after us.
+			MainLoop::getInstance();
+		}
+
+	public:
+
+		~Registry() {
+			clear();
+		}
+
+		static Registry & getInstance() {
+			static Registry instance;
+			return instance;
+		}
+
+		std::shared_ptr<Abstract::DBus::Connection> get(DBusBusType type) {
+
+			if(((size_t) type) >= (sizeof(connections)/sizeof(connections[0]))) {
+				throw system_error(EINVAL,system_category(),"Invalid bus type");
+			}
+
+			lock_guard<mutex> lock(guard);
+
+			auto &connection = connections[type];
+			if(!connection) {
+
+				switch(type) {
+				case DBUS_BUS_SYSTEM:
+					connection = make_shared<DBus::SystemBus>();
+					break;
+
+				case DBUS_BUS_SESSION:
+					connection = make_shared<DBus::SessionBus>();
+					break;
+
+				case DBUS_BUS_STARTER:
+					connection = make_shared<DBus::StarterBus>();
+					break;
+				}
+
+				Logger::String{"Shared connection is now open"}.trace(connection->name());
+
+			}
+
+			return connection;
+
+		}
+
+		void clear() noexcept {
+
+			lock_guard<mutex> lock(guard);
+
+			for(auto &connection : connections) {
+
+				if(!connection) {
+					continue;
+				}
+
+				if(connection.use_count() > 1) {
+					Logger::String{"Releasing shared connection with ",(connection.use_count()-1)," active user(s)"}.warning(connection->name());
+				} else {
+					Logger::String{"Releasing shared connection"}.trace(connection->name());
+				}
+
+				connection.reset();
+
+			}
+
+		}
+
+	};
+
+	std::shared_ptr<Abstract::DBus::Connection> Abstract::DBus::Connection::getInstance(DBusBusType type) {
+		return Registry::getInstance().get(type);
+	}
+
+	void Abstract::DBus::Connection::release() noexcept {
+		Registry::getInstance().clear();
+	}
+
+	std::shared_ptr<DBus::SystemBus> DBus::SystemBus::getInstance() {
+		return static_pointer_cast<DBus::SystemBus>(Abstract::DBus::Connection::getInstance(DBUS_BUS_SYSTEM));
+	}
+
+	std::shared_ptr<DBus::SessionBus> DBus::SessionBus::getInstance() {
+		return static_pointer_cast<DBus::SessionBus>(Abstract::DBus::Connection::getInstance(DBUS_BUS_SESSION));
+	}
+
+	std::shared_ptr<DBus::StarterBus> DBus::StarterBus::getInstance() {
+		return static_pointer_cast<DBus::StarterBus>(Abstract::DBus::Connection::getInstance(DBUS_BUS_STARTER));
+	}
+
+ }
+
@@ -0,0 +1,385 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the exported object server.
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <dbus/dbus.h>
+ #include <udjat/tools/dbus/connection.h>
+ #include <udjat/tools/dbus/message.h>
+ #include <udjat/tools/dbus/request.h>
+ #include <udjat/tools/logger.h>
+ #include <private/server.h>
+ #include <private/queue.h>
+ #include <algorithm>
+ #include <cstring>
+ #include <mutex>
+ #include <shared_mutex>
+ #include <system_error>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	/// @brief Get the next segment of an object path.
+	/// @param path The path, moved to the end of the segment.
+	/// @return The segment, empty at the end of the path.
+	static std::string_view segment(const char * &path) noexcept {
+
+		while(*path == '/') {
+			path++;
+		}
+
+		const char *begin = path;
+		while(*path && *path != '/') {
+			path++;
+		}
+
+		return std::string_view{begin,(size_t) (path-begin)};
+
+	}
+
+	/// @brief Compare child segment with name, for sorted lookup.
+	template<typename T>
+	static bool before(const T &node, std::string_view name) noexcept {
+		return std::string_view{node->name} < name;
+	}
+
+	Abstract::DBus::Connection::ObjectServer::Method::Method(const char *i, const char *m, const Udjat::DBus::Method &h, std::shared_ptr<Udjat::DBus::Member::Queue> q)
+		: queue{q}, interface{i}, member{m}, handler{h}, hash{Udjat::DBus::hash(Udjat::DBus::hash(i),Udjat::DBus::hash(m))} {
+	}
+
+	Abstract::DBus::Connection::ObjectServer::Method::~Method() {
+		if(queue) {
+			queue->stop();
+		}
+	}
+
+	void Abstract::DBus::Connection::ObjectServer::Method::call(DBusConnection *conn, DBusMessage *message) const {
+
+		if(queue) {
+			queue->push(message);
+			return;
+		}
+
+		auto request = make_shared<Udjat::DBus::Request>(conn,message);
+
+		try {
+
+			handler(request);
+
+		} catch(const std::exception &e) {
+
+			request->failed(e);
+
+		} catch(...) {
+
+			request->failed(DBUS_ERROR_FAILED,"Unexpected error");
+
+		}
+
+	}
+
+	Abstract::DBus::Connection::ObjectServer::Node * Abstract::DBus::Connection::ObjectServer::Node::child(std::string_view name, bool insert) {
+
+		auto it = std::lower_bound(children.begin(),children.end(),name,before<std::unique_ptr<Node>>);
+		if(it != children.end() && (*it)->name == name) {
+			return it->get();
+		}
+
+		if(!insert) {
+			return nullptr;
+		}
+
+		return children.insert(it,std::make_unique<Node>(name))->get();
+
+	}
+
+	Abstract::DBus::Connection::ObjectServer::Node * Abstract::DBus::Connection::ObjectServer::find(const char *path, bool insert) {
+
+		Node *node = &root;
+
+		for(std::string_view name = segment(path); node && !name.empty(); name = segment(path)) {
+			node = node->child(name,insert);
+		}
+
+		return node;
+
+	}
+
+	void Abstract::DBus::Connection::ObjectServer::insert(const char *path, std::shared_ptr<const Method> method) {
+
+		auto &bucket = find(path,true)->methods[method->hash];
+
+		for(auto &entry : bucket) {
+			if(entry->interface == method->interface && entry->member == method->member) {
+				entry = method;
+				return;
+			}
+		}
+
+		bucket.push_back(method);
+
+	}
+
+	size_t Abstract::DBus::Connection::ObjectServer::remove(Node &node, const char *path, const char *interface) {
+
+		std::string_view name = segment(path);
+
+		if(name.empty()) {
+
+			size_t count = 0;
+
+			for(auto bucket = node.methods.begin(); bucket != node.methods.end();) {
+
+				auto &methods = bucket->second;
+				auto last = std::remove_if(methods.begin(),methods.end(),[interface](const std::shared_ptr<const Method> &method){
+					return !interface || method->interface == interface;
+				});
+
+				count += (methods.end() - last);
+				methods.erase(last,methods.end());
+
+				if(methods.empty()) {
+					bucket = node.methods.erase(bucket);
+				} else {
+					bucket++;
+				}
+
+			}
+
+			return count;
+
+		}
+
+		auto it = std::lower_bound(node.children.begin(),node.children.end(),name,before<std::unique_ptr<Node>>);
+		if(it == node.children.end() || (*it)->name != name) {
+			return 0;
+		}
+
+		size_t count = remove(**it,path,interface);
+
+		// Prune the segments without methods.
+		if((*it)->empty()) {
+			node.children.erase(it);
+		}
+
+		return count;
+
+	}
+
+	size_t Abstract::DBus::Connection::ObjectServer::remove(const char *path, const char *interface) {
+		return remove(root,path,interface);
+	}
+
+	std::shared_ptr<const Abstract::DBus::Connection::ObjectServer::Method> Abstract::DBus::Connection::ObjectServer::find(const char *path, const char *interface, const char *member) const noexcept {
+
+		const Node *node = &root;
+
+		for(std::string_view name = segment(path); !name.empty(); name = segment(path)) {
+
+			auto it = std::lower_bound(node->children.begin(),node->children.end(),name,before<std::unique_ptr<Node>>);
+			if(it == node->children.end() || (*it)->name != name) {
+				return std::shared_ptr<const Method>();
+			}
+
+			node = it->get();
+		}
+
+		if(!interface) {
+
+			// No interface on the call, any method with the name will do.
+			for(const auto &bucket : node->methods) {
+				for(const auto &method : bucket.second) {
+					if(method->member == member) {
+						return method;
+					}
+				}
+			}
+
+			return std::shared_ptr<const Method>();
+		}
+
+		auto bucket = node->methods.find(Udjat::DBus::hash(Udjat::DBus::hash(interface),Udjat::DBus::hash(member)));
+		if(bucket != node->methods.end()) {
+
+			// Check names, the hash can collide.
+			for(const auto &method : bucket->second) {
+				if(method->interface == interface && method->member == member) {
+					return method;
+				}
+			}
+
+		}
+
+		return std::shared_ptr<const Method>();
+
+	}
+
+	void Abstract::DBus::Connection::register_method(const char *path, const char *interface, const char *member, const Udjat::DBus::Method &method) {
+		register_method(path,interface,member,Udjat::DBus::Member::Dispatch{},method);
+	}
+
+	void Abstract::DBus::Connection::register_method(const char *path, const char *interface, const char *member, const Udjat::DBus::Member::Dispatch &dispatch, const Udjat::DBus::Method &handler) {
+
+		if(!dbus_validate_path(path,NULL)) {
+			throw system_error(EINVAL,system_category(),string{"Invalid d-bus object path '"} + path + "'");
+		}
+
+		if(!dbus_validate_interface(interface,NULL)) {
+			throw system_error(EINVAL,system_category(),string{"Invalid d-bus interface name '"} + interface + "'");
+		}
+
+		if(!dbus_validate_member(member,NULL)) {
+			throw system_error(EINVAL,system_category(),string{"Invalid d-bus member name '"} + member + "'");
+		}
+
+		// Coalescing or holding calls would leave the callers without reply.
+		Udjat::DBus::Member::Dispatch settings{dispatch.mode,dispatch.limit};
+
+		std::shared_ptr<Udjat::DBus::Member::Queue> queue;
+		if(settings.mode != Udjat::DBus::Member::Dispatch::Inline) {
+
+			// The queue can outlive this object, keep the libdbus connection.
+			std::shared_ptr<DBusConnection> connection{dbus_connection_ref(conn),dbus_connection_unref};
+
+			queue = make_shared<Udjat::DBus::Member::Queue>(
+				(string{path} + " " + interface + "." + member).c_str(),
+				settings,
+				[connection,handler](Udjat::DBus::Message &message) {
+
+					auto request = make_shared<Udjat::DBus::Request>(connection.get(),(DBusMessage *) message);
+
+					try {
+
+						handler(request);
+
+					} catch(const std::exception &e) {
+
+						request->failed(e);
+
+					} catch(...) {
+
+						request->failed(DBUS_ERROR_FAILED,"Unexpected error");
+
+					}
+
+				},
+				[connection](DBusMessage *message, const char *name, const char *text) {
+					Udjat::DBus::Request{connection.get(),message}.failed(name,text);
+				}
+			);
+
+			queue->start();
+
+		}
+
+		auto method = make_shared<const ObjectServer::Method>(interface,member,handler,queue);
+
+		{
+			lock_guard<shared_mutex> lock(guard);
+
+			if(!server) {
+				server = new ObjectServer();
+			}
+
+			server->insert(path,method);
+		}
+
+		Logger::String{"Exporting ",interface,".",member," on '",path,"'"}.trace(name());
+
+	}
+
+	size_t Abstract::DBus::Connection::unregister(const char *path, const char *interface) {
+
+		size_t count = 0;
+
+		{
+			lock_guard<shared_mutex> lock(guard);
+
+			if(!server) {
+				return 0;
+			}
+
+			count = server->remove(path,interface);
+
+			if(server->empty()) {
+				delete server;
+				server = nullptr;
+			}
+		}
+
+		if(count) {
+			Logger::String{"Unexported ",count," method(s) from '",path,"'"}.trace(name());
+		}
+
+		return count;
+
+	}
+
+	DBusHandlerResult Abstract::DBus::Connection::on_method(DBusMessage *message) noexcept {
+
+		const char *path = dbus_message_get_path(message);
+		const char *member = dbus_message_get_member(message);
+
+		if(!(path && member)) {
+			return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+		}
+
+		// Get the method and release the guard, the handlers can export and unexport methods.
+		std::shared_ptr<const ObjectServer::Method> method;
+		{
+			shared_lock<shared_mutex> lock(guard);
+			if(server) {
+				method = server->find(path,dbus_message_get_interface(message),member);
+			}
+		}
+
+		if(!method) {
+			// Not ours, libdbus will reply with UnknownMethod.
+			return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+		}
+
+		if(Logger::enabled(Logger::Trace)) {
+			Logger::String{"Method call ",method->interface.c_str(),".",member," on '",path,"'"}.trace(name());
+		}
+
+		// The handler errors are replied by call(), only the dispatch can fail here.
+		try {
+
+			method->call(conn,message);
+
+		} catch(const std::exception &e) {
+
+			Logger::String{method->interface.c_str(),".",member,": ",e.what()}.error(name());
+
+		} catch(...) {
+
+			Logger::String{method->interface.c_str(),".",member,": Unexpected error"}.error(name());
+
+		}
+
+		return DBUS_HANDLER_RESULT_HANDLED;
+
+	}
+
+ }
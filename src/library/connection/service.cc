@@ -0,0 +1,471 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2015 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the dedicated I/O and dispatch thread.
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <private/mainloop.h>
+ #include <private/queue.h>
+ #include <udjat/tools/logger.h>
+ #include <sys/epoll.h>
+ #include <sys/eventfd.h>
+ #include <unistd.h>
+ #include <system_error>
+ #include <algorithm>
+
+/*---[ Implement ]----------------------------------------------------------------------------------*/
+
+ Abstract::DBus::Connection::Service::Service(Abstract::DBus::Connection &c) : connection{c}, epfd{epoll_create1(EPOLL_CLOEXEC)}, efd{-1} {
+
+	if(epfd < 0) {
+		throw system_error(errno,system_category(),"Cant create d-bus epoll descriptor");
+	}
+
+	efd = eventfd(0,EFD_NONBLOCK|EFD_CLOEXEC);
+	if(efd < 0) {
+		int err = errno;
+		::close(epfd);
+		throw system_error(err,system_category(),"Cant create d-bus eventfd");
+	}
+
+	struct epoll_event event;
+	memset(&event,0,sizeof(event));
+	event.events = EPOLLIN;
+	event.data.fd = efd;
+
+	if(epoll_ctl(epfd,EPOLL_CTL_ADD,efd,&event)) {
+		int err = errno;
+		::close(efd);
+		::close(epfd);
+		throw system_error(err,system_category(),"Cant watch d-bus eventfd");
+	}
+
+ }
+
+ Abstract::DBus::Connection::Service::~Service() {
+	::close(efd);
+	::close(epfd);
+ }
+
+ void Abstract::DBus::Connection::Service::start() {
+	thread = std::thread{[this](){
+		run();
+	}};
+ }
+
+ void Abstract::DBus::Connection::Service::stop() {
+	enabled = false;
+	wakeup();
+	if(thread.joinable()) {
+		thread.join();
+	}
+ }
+
+ void Abstract::DBus::Connection::Service::detach() {
+	enabled = false;
+	detached = true;
+	thread.detach();
+	wakeup();
+ }
+
+ void Abstract::DBus::Connection::Service::wakeup() noexcept {
+	uint64_t value = 1;
+	if(write(efd,&value,sizeof(value)) != sizeof(value)) {
+		Logger::String{"Cant signal d-bus thread: ",strerror(errno)}.error(connection.name());
+	}
+ }
+
+ void Abstract::DBus::Connection::Service::update(int fd) {
+
+	auto entry = fds.find(fd);
+	if(entry == fds.end()) {
+		return;
+	}
+
+	uint32_t events = 0;
+	for(DBusWatch *watch : entry->second.watches) {
+
+		if(!dbus_watch_get_enabled(watch)) {
+			continue;
+		}
+
+		unsigned int flags = dbus_watch_get_flags(watch);
+
+		if(flags & DBUS_WATCH_READABLE) {
+			events |= EPOLLIN;
+		}
+
+		if(flags & DBUS_WATCH_WRITABLE) {
+			events |= EPOLLOUT;
+		}
+
+	}
+
+	struct epoll_event event;
+	memset(&event,0,sizeof(event));
+	event.events = events;
+	event.data.fd = fd;
+
+	if(!events) {
+
+		// Nothing enabled, stop watching or the hangup would wake us forever.
+		if(entry->second.registered) {
+			epoll_ctl(epfd,EPOLL_CTL_DEL,fd,NULL);
+			entry->second.registered = false;
+		}
+
+	} else if(!entry->second.registered) {
+
+		if(epoll_ctl(epfd,EPOLL_CTL_ADD,fd,&event)) {
+			Logger::String{"Cant watch socket ",fd,": ",strerror(errno)}.error(connection.name());
+		} else {
+			entry->second.registered = true;
+		}
+
+	} else if(entry->second.events != events) {
+
+		if(epoll_ctl(epfd,EPOLL_CTL_MOD,fd,&event)) {
+			Logger::String{"Cant update socket ",fd,": ",strerror(errno)}.error(connection.name());
+		}
+
+	}
+
+	entry->second.events = events;
+
+	if(entry->second.watches.empty()) {
+		fds.erase(entry);
+	}
+
+ }
+
+ void Abstract::DBus::Connection::Service::handle(int fd, uint32_t events) {
+
+	{
+		lock_guard<mutex> lock(guard);
+		auto entry = fds.find(fd);
+		if(entry == fds.end()) {
+			return;
+		}
+		handling = entry->second.watches;
+	}
+
+	// Without the lock, libdbus can toggle the watches from here.
+	for(DBusWatch *watch : handling) {
+
+		if(!dbus_watch_get_enabled(watch)) {
+			continue;
+		}
+
+		unsigned int available = dbus_watch_get_flags(watch);
+		unsigned int flags = 0;
+
+		if((events & EPOLLIN) && (available & DBUS_WATCH_READABLE)) {
+			flags |= DBUS_WATCH_READABLE;
+		}
+
+		if((events & EPOLLOUT) && (available & DBUS_WATCH_WRITABLE)) {
+			flags |= DBUS_WATCH_WRITABLE;
+		}
+
+		if(events & EPOLLHUP) {
+			flags |= DBUS_WATCH_HANGUP;
+		}
+
+		if(events & EPOLLERR) {
+			flags |= DBUS_WATCH_ERROR;
+		}
+
+		if(flags && dbus_watch_handle(watch,flags) == FALSE) {
+			Logger::String{"dbus_watch_handle() failed"}.error(connection.name());
+		}
+
+	}
+
+ }
+
+ int Abstract::DBus::Connection::Service::next_timeout() {
+
+	lock_guard<mutex> lock(guard);
+
+	int rc = -1;
+	auto now = std::chrono::steady_clock::now();
+
+	for(const Timeout &timeout : timeouts) {
+
+		if(!dbus_timeout_get_enabled(timeout.timeout)) {
+			continue;
+		}
+
+		int ms = 0;
+		if(timeout.deadline > now) {
+			ms = (int) std::chrono::duration_cast<std::chrono::milliseconds>(timeout.deadline - now).count() + 1;
+		}
+
+		if(rc < 0 || ms < rc) {
+			rc = ms;
+		}
+
+	}
+
+	return rc;
+
+ }
+
+ void Abstract::DBus::Connection::Service::expire() {
+
+	expired.clear();
+
+	{
+		lock_guard<mutex> lock(guard);
+		auto now = std::chrono::steady_clock::now();
+
+		for(Timeout &timeout : timeouts) {
+			if(dbus_timeout_get_enabled(timeout.timeout) && timeout.deadline <= now) {
+				expired.emplace_back(timeout.timeout,timeout.id);
+				timeout.deadline = now + std::chrono::milliseconds(dbus_timeout_get_interval(timeout.timeout));
+			}
+		}
+
+	}
+
+	for(const auto &entry : expired) {
+
+		{
+			// The previous handlers can remove or disable it.
+			lock_guard<mutex> lock(guard);
+
+			auto it = std::find_if(timeouts.begin(),timeouts.end(),[&entry](const Timeout &timeout){
+				return timeout.id == entry.second;
+			});
+
+			if(it == timeouts.end() || !dbus_timeout_get_enabled(entry.first)) {
+				continue;
+			}
+		}
+
+		// Can't hold a lock here, libdbus removes the timeouts with its connection lock held and
+		// the handler takes the same lock.
+		dbus_timeout_handle(entry.first);
+
+	}
+
+ }
+
+ void Abstract::DBus::Connection::Service::run() {
+
+	Logger::String{"Dedicated d-bus thread started"}.trace(connection.name());
+
+	// A full signal queue must not block the dispatch after stop(), it would wait for the join.
+	Udjat::DBus::Member::Queue::bind(&enabled);
+
+	struct epoll_event events[16];
+
+	while(enabled) {
+
+		// Messages left by the dispatch budget, poll without waiting.
+		int timeout = (connection.dispatch() ? 0 : next_timeout());
+
+		int count = epoll_wait(epfd,events,(sizeof(events)/sizeof(events[0])),timeout);
+		if(count < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			Logger::String{"epoll_wait() failed: ",strerror(errno)}.error(connection.name());
+			break;
+		}
+
+		for(int ix = 0; ix < count; ix++) {
+
+			if(events[ix].data.fd == efd) {
+				uint64_t value;
+				if(read(efd,&value,sizeof(value)) < 0 && errno != EAGAIN) {
+					Logger::String{"Cant read d-bus eventfd: ",strerror(errno)}.error(connection.name());
+				}
+				continue;
+			}
+
+			handle(events[ix].data.fd,events[ix].events);
+
+		}
+
+		expire();
+
+	}
+
+	Udjat::DBus::Member::Queue::bind(nullptr);
+
+	if(detached) {
+		// Nobody will join, the connection can be gone already.
+		Logger::String{"Detached d-bus thread stopped"}.trace("d-bus");
+		delete this;
+		return;
+	}
+
+	Logger::String{"Dedicated d-bus thread stopped"}.trace(connection.name());
+
+ }
+
+ dbus_bool_t Abstract::DBus::Connection::Service::add_watch(DBusWatch *w, Service *service) {
+	lock_guard<mutex> lock(service->guard);
+	int fd = dbus_watch_get_unix_fd(w);
+	service->fds[fd].watches.push_back(w);
+	service->update(fd);
+	return TRUE;
+ }
+
+ void Abstract::DBus::Connection::Service::remove_watch(DBusWatch *w, Service *service) {
+
+	lock_guard<mutex> lock(service->guard);
+
+	for(auto &entry : service->fds) {
+		auto &watches = entry.second.watches;
+		for(auto it = watches.begin(); it != watches.end(); it++) {
+			if(*it == w) {
+				watches.erase(it);
+				service->update(entry.first);
+				return;
+			}
+		}
+	}
+
+ }
+
+ void Abstract::DBus::Connection::Service::toggle_watch(DBusWatch *w, Service *service) {
+	lock_guard<mutex> lock(service->guard);
+	service->update(dbus_watch_get_unix_fd(w));
+ }
+
+ dbus_bool_t Abstract::DBus::Connection::Service::add_timeout(DBusTimeout *t, Service *service) {
+	{
+		lock_guard<mutex> lock(service->guard);
+		service->timeouts.push_back(Timeout{t,std::chrono::steady_clock::now() + std::chrono::milliseconds(dbus_timeout_get_interval(t)),++service->added});
+	}
+	service->wakeup();
+	return TRUE;
+ }
+
+ void Abstract::DBus::Connection::Service::remove_timeout(DBusTimeout *t, Service *service) {
+	lock_guard<mutex> lock(service->guard);
+	for(auto it = service->timeouts.begin(); it != service->timeouts.end(); it++) {
+		if(it->timeout == t) {
+			service->timeouts.erase(it);
+			return;
+		}
+	}
+ }
+
+ void Abstract::DBus::Connection::Service::toggle_timeout(DBusTimeout *t, Service *service) {
+	{
+		lock_guard<mutex> lock(service->guard);
+		for(Timeout &timeout : service->timeouts) {
+			if(timeout.timeout == t) {
+				timeout.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(dbus_timeout_get_interval(t));
+				break;
+			}
+		}
+	}
+	service->wakeup();
+ }
+
+ void Abstract::DBus::Connection::start_thread() {
+
+	lock_guard<mutex> lock(threading);
+
+	if(service.load()) {
+		return;
+	}
+
+	Service *started = new Service(*this);
+	service.store(started);
+
+	// Undo on failure, wakeup() can be using the new service.
+	auto failed = [this,started](const char *message) {
+		service.store(nullptr);
+		bind();
+		while(waking.load()) {
+			std::this_thread::yield();
+		}
+		delete started;
+		throw runtime_error(message);
+	};
+
+	// libdbus moves the current watches and timeouts to the new functions.
+	if(!dbus_connection_set_watch_functions(
+		conn,
+		(DBusAddWatchFunction) Service::add_watch,
+		(DBusRemoveWatchFunction) Service::remove_watch,
+		(DBusWatchToggledFunction) Service::toggle_watch,
+		started,
+		nullptr)
+	) {
+		failed("dbus_connection_set_watch_functions has failed");
+	}
+
+	if(!dbus_connection_set_timeout_functions(
+		conn,
+		(DBusAddTimeoutFunction) Service::add_timeout,
+		(DBusRemoveTimeoutFunction) Service::remove_timeout,
+		(DBusTimeoutToggledFunction) Service::toggle_timeout,
+		started,
+		nullptr)
+	) {
+		failed("dbus_connection_set_timeout_functions has failed");
+	}
+
+	started->start();
+	Logger::String{"I/O and dispatch moved to dedicated thread"}.trace(name());
+
+ }
+
+ void Abstract::DBus::Connection::stop_thread() {
+
+	lock_guard<mutex> lock(threading);
+
+	Service *stopped = service.load();
+	if(!stopped) {
+		return;
+	}
+
+	// The thread can't join itself (close() from a callback), it leaves after the current dispatch.
+	bool self = stopped->current();
+	if(self) {
+		stopped->detach();
+	} else {
+		stopped->stop();
+	}
+
+	service.store(nullptr);
+	bind();
+
+	// Wait for the wakeup() calls still using the service.
+	while(waking.load()) {
+		std::this_thread::yield();
+	}
+
+	if(!self) {
+		delete stopped;
+	}
+
+	Logger::String{"I/O and dispatch returned to the main loop"}.trace(name());
+	wakeup();
+
+ }
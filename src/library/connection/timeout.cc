@@ -23,35 +23,378 @@
  #include <udjat/tools/timer.h>
  #include <private/mainloop.h>
  #include <unistd.h>
+ #include <mutex>
+ #include <vector>
+ #include <limits>
+ #include <memory>
+ #include <chrono>
 
- class TimeoutContext : public Udjat::MainLoop::Timer {
- public:
+ /// @brief D-Bus timeout in the timer wheel.
+ struct TimeoutContext {
 
-	DBusConnection	* conn = nullptr;
 	DBusTimeout		* timeout = nullptr;
 
-	TimeoutContext() {
+	/// @brief Expiration tick.
+	uint64_t expires = 0;
+
+	/// @brief Interval in ticks.
+	uint64_t interval = 0;
+
+	/// @brief Slot list (or pool list, when not in use).
+	TimeoutContext	* prev = nullptr;
+	TimeoutContext	* next = nullptr;
+
+	/// @brief The slot head, nullptr if not scheduled.
+	TimeoutContext	** slot = nullptr;
+
+	/// @brief Incremented when the context returns to the pool, the contexts are reused.
+	uint64_t generation = 0;
+
+ };
+
+ /// @brief Hierarchical timer wheel for all d-bus timeouts, driven by a single main loop timer.
+ class TimeoutWheel : public Udjat::MainLoop::Timer {
+ private:
+
+	static constexpr unsigned long tick = 10;			///< @brief Tick length in milliseconds.
+	static constexpr size_t bits = 6;					///< @brief Slots per level, as power of 2.
+	static constexpr size_t slots = (1 << bits);
+	static constexpr size_t levels = 4;					///< @brief Range is (slots ^ levels) ticks, about 46 hours.
+
+	std::mutex guard;
+
+	TimeoutContext * wheel[levels][slots];
+
+	/// @brief Current tick.
+	uint64_t now = 0;
+
+	/// @brief Number of scheduled timeouts.
+	size_t active = 0;
+
+	/// @brief The tick the main loop timer is armed for.
+	uint64_t armed = 0;
+
+	std::chrono::steady_clock::time_point started;
+
+	/// @brief Free contexts.
+	TimeoutContext * available = nullptr;
+
+	/// @brief Memory for the contexts, allocated in blocks and never released.
+	std::vector<std::unique_ptr<TimeoutContext[]>> blocks;
+
+	/// @brief Timeout fired on the last tick.
+	struct Expired {
+		TimeoutContext *ctx;
+		DBusTimeout *timeout;
+		uint64_t generation;
+	};
+
+	/// @brief Timeouts fired on the last tick, reused between ticks.
+	std::vector<Expired> expired;
+
+	TimeoutWheel() {
+
+		// The wheel is a main loop timer, construct it first so it will be destroyed after us.
+		Udjat::MainLoop::getInstance();
+
+		for(size_t level = 0; level < levels; level++) {
+			for(size_t ix = 0; ix < slots; ix++) {
+				wheel[level][ix] = nullptr;
+			}
+		}
+
+		started = std::chrono::steady_clock::now();
+
+	}
+
+	inline uint64_t elapsed() const noexcept {
+		return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count();
+	}
+
+	inline uint64_t current() const noexcept {
+		return elapsed() / tick;
+	}
+
+	/// @brief Get the next tick with work, an expiration on the first level or a cascade from the upper ones.
+	uint64_t next() const noexcept {
+
+		uint64_t rc = std::numeric_limits<uint64_t>::max();
+
+		for(uint64_t ix = now + 1; ix <= now + slots; ix++) {
+			if(wheel[0][ix & (slots-1)]) {
+				rc = ix;
+				break;
+			}
+		}
+
+		for(size_t level = 1; level < levels; level++) {
+
+			uint64_t base = (now >> (bits * level));
+
+			for(uint64_t ix = base + 1; ix <= base + slots; ix++) {
+				if(wheel[level][ix & (slots-1)]) {
+					rc = std::min(rc,ix << (bits * level));
+					break;
+				}
+			}
+
+		}
+
+		return rc;
+
+	}
+
+	/// @brief Arm the main loop timer for the next tick with work, must be called with the guard locked.
+	void arm() {
+
+		armed = next();
+		if(armed == std::numeric_limits<uint64_t>::max()) {
+			return;
+		}
+
+		uint64_t at = armed * tick;
+		uint64_t ms = elapsed();
+
+		reset(at > ms ? (unsigned long) (at - ms) : 1);
+
+	}
+
+	void link(TimeoutContext *ctx) noexcept {
+
+		uint64_t delta = (ctx->expires > now ? ctx->expires - now : 0);
+
+		if(delta >= (((uint64_t) 1) << (bits * levels))) {
+			delta = (((uint64_t) 1) << (bits * levels)) - 1;
+			ctx->expires = now + delta;
+		}
+
+		size_t level = 0;
+		while(level < (levels-1) && delta >= (((uint64_t) 1) << (bits * (level+1)))) {
+			level++;
+		}
+
+		TimeoutContext **slot = &wheel[level][(ctx->expires >> (bits * level)) & (slots-1)];
+
+		ctx->slot = slot;
+		ctx->prev = nullptr;
+		ctx->next = *slot;
+		if(*slot) {
+			(*slot)->prev = ctx;
+		}
+		*slot = ctx;
+
+	}
+
+	void unlink(TimeoutContext *ctx) noexcept {
+
+		if(ctx->prev) {
+			ctx->prev->next = ctx->next;
+		} else {
+			*ctx->slot = ctx->next;
+		}
+
+		if(ctx->next) {
+			ctx->next->prev = ctx->prev;
+		}
+
+		ctx->prev = ctx->next = nullptr;
+		ctx->slot = nullptr;
+
+	}
+
+	/// @brief Move the timeouts from a higher level slot to the lower levels.
+	void cascade(size_t level) noexcept {
+
+		TimeoutContext *ctx = wheel[level][(now >> (bits * level)) & (slots-1)];
+		wheel[level][(now >> (bits * level)) & (slots-1)] = nullptr;
+
+		while(ctx) {
+			TimeoutContext *next = ctx->next;
+			link(ctx);
+			ctx = next;
+		}
+
+	}
+
+	/// @brief Advance one tick, collect the expired timeouts.
+	void advance() {
+
+		now++;
+
+		for(size_t level = 1; level < levels && !(now & ((((uint64_t) 1) << (bits * level)) - 1)); level++) {
+			cascade(level);
+		}
+
+		TimeoutContext *ctx = wheel[0][now & (slots-1)];
+		wheel[0][now & (slots-1)] = nullptr;
+
+		while(ctx) {
+
+			TimeoutContext *next = ctx->next;
+
+			// D-Bus timeouts are periodic until disabled or removed.
+			if(ctx->expires <= now) {
+				expired.push_back(Expired{ctx,ctx->timeout,ctx->generation});
+				ctx->expires = now + ctx->interval;
+			}
+			link(ctx);
+
+			ctx = next;
+		}
+
 	}
 
  protected:
+
 	void on_timer() override {
-		dbus_timeout_handle(this->timeout);
+
+		{
+			std::lock_guard<std::mutex> lock(guard);
+
+			expired.clear();
+			uint64_t target = current();
+			while(now < target) {
+				advance();
+			}
+
+			if(active) {
+				arm();
+			}
+
+		}
+
+		for(const Expired &entry : expired) {
+
+			{
+				// The previous handlers can remove or disable it, the context would be back in the pool.
+				std::lock_guard<std::mutex> lock(guard);
+				if(entry.ctx->generation != entry.generation || entry.ctx->timeout != entry.timeout || !entry.ctx->slot) {
+					continue;
+				}
+			}
+
+			// Can't hold a lock here, libdbus removes the timeouts with its connection lock held and
+			// the handler takes the same lock.
+			dbus_timeout_handle(entry.timeout);
+
+		}
+
 	}
 
- };
+ public:
+
+	static TimeoutWheel & getInstance() {
+		static TimeoutWheel instance;
+		return instance;
+	}
 
- dbus_bool_t add_timeout(DBusTimeout *t, Abstract::DBus::Connection *connection) {
+	/// @brief Get context from the pool.
+	TimeoutContext * acquire(DBusTimeout *timeout) {
 
-	TimeoutContext *ctx = new TimeoutContext();
+		std::lock_guard<std::mutex> lock(guard);
 
-	ctx->conn		= connection->connection();
-	ctx->timeout	= t;
-	ctx->reset(dbus_timeout_get_interval(t));
+		if(!available) {
+
+			static constexpr size_t length = 64;
+
+			blocks.emplace_back(new TimeoutContext[length]);
+			TimeoutContext *block = blocks.back().get();
+
+			for(size_t ix = 0; ix < length; ix++) {
+				block[ix].next = available;
+				available = &block[ix];
+			}
+
+		}
+
+		TimeoutContext *ctx = available;
+		available = ctx->next;
+
+		ctx->timeout = timeout;
+		ctx->prev = ctx->next = nullptr;
+		ctx->slot = nullptr;
+
+		return ctx;
+
+	}
+
+	/// @brief Return context to the pool.
+	void release(TimeoutContext *ctx) noexcept {
+
+		std::lock_guard<std::mutex> lock(guard);
+
+		if(ctx->slot) {
+			unlink(ctx);
+			if(!--active) {
+				disable();
+			}
+		}
+
+		ctx->timeout = nullptr;
+		ctx->generation++;
+		ctx->next = available;
+		available = ctx;
+
+	}
+
+	/// @brief Schedule timeout, replacing the previous schedule.
+	void schedule(TimeoutContext *ctx, unsigned long milliseconds) noexcept {
+
+		std::lock_guard<std::mutex> lock(guard);
+
+		bool idle = false;
+
+		if(ctx->slot) {
+			unlink(ctx);
+		} else if(!active++) {
+			// The wheel was idle, resync the current tick.
+			now = current();
+			idle = true;
+		}
+
+		ctx->interval = (milliseconds + tick - 1) / tick;
+		if(!ctx->interval) {
+			ctx->interval = 1;
+		}
+		ctx->expires = now + ctx->interval;
+		link(ctx);
+
+		// The timer sleeps until the next occupied slot, wake it sooner if needed.
+		if(idle || ctx->expires < armed) {
+			arm();
+		}
+
+		if(idle) {
+			enable();
+		}
+
+	}
+
+	/// @brief Unschedule timeout.
+	void cancel(TimeoutContext *ctx) noexcept {
+
+		std::lock_guard<std::mutex> lock(guard);
+
+		if(ctx->slot) {
+			unlink(ctx);
+			if(!--active) {
+				disable();
+			}
+		}
+
+	}
+
+ };
+
+ dbus_bool_t add_timeout(DBusTimeout *t, Abstract::DBus::Connection *) {
+
+	TimeoutWheel &wheel = TimeoutWheel::getInstance();
+	TimeoutContext *ctx = wheel.acquire(t);
 
 	dbus_timeout_set_data(t, ctx, NULL);
 
-	if(dbus_timeout_get_enabled(ctx->timeout)) {
-		ctx->enable();
+	if(dbus_timeout_get_enabled(t)) {
+		wheel.schedule(ctx,dbus_timeout_get_interval(t));
 	}
 
 	return TRUE;
@@ -62,7 +405,8 @@
 	TimeoutContext *ctx = (TimeoutContext *) dbus_timeout_get_data(t);
 
 	if(ctx) {
-		delete ctx;
+		dbus_timeout_set_data(t, NULL, NULL);
+		TimeoutWheel::getInstance().release(ctx);
 	}
  }
 
@@ -72,17 +416,12 @@
 
 	if(ctx) {
 
-		ctx->disable();
-
-		if (dbus_timeout_get_enabled(ctx->timeout)) {
-
-			ctx->reset(dbus_timeout_get_interval(ctx->timeout));
-			ctx->enable();
-
+		if (dbus_timeout_get_enabled(t)) {
+			TimeoutWheel::getInstance().schedule(ctx,dbus_timeout_get_interval(t));
+		} else {
+			TimeoutWheel::getInstance().cancel(ctx);
 		}
 
 	}
 
  }
-
-
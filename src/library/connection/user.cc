@@ -33,7 +33,11 @@
  #include <sys/types.h>
  #include <sys/stat.h>
  #include <udjat/tools/file.h>
+ #include <udjat/tools/mainloop.h>
  #include <pwd.h>
+ #include <mutex>
+ #include <unordered_map>
+ #include <vector>
 
  #ifdef HAVE_SYSTEMD
 	#include <systemd/sd-login.h>
@@ -43,11 +47,155 @@
 
  namespace Udjat {
 
-	static DBusConnection * UserConnectionFactory(uid_t uid, const char *sid) {
+	/// @brief Cache of user bus addresses, indexed by uid and session id (only uid for the systemd user bus).
+	class UserBusAddresses {
+	public:
 
-		/// @brief File on /proc/[PID]/environ
+		struct Entry {
+			std::string address;	///< @brief The DBUS_SESSION_BUS_ADDRESS value.
+			std::string path;		///< @brief Path to check for validity (socket or /proc/[PID]).
+			bool shared = false;	///< @brief True for the systemd user bus, shared by all sessions.
+		};
 
-		Logger::String{"Opening connection to user '",uid,"'"}.trace("d-bus");
+	private:
+
+		std::mutex guard;
+		std::unordered_map<std::string,Entry> entries;
+
+#ifdef HAVE_SYSTEMD
+		/// @brief Drop the cache when logind sessions come and go.
+		class Monitor : public MainLoop::Handler {
+		private:
+			sd_login_monitor *monitor = nullptr;
+
+		protected:
+			void handle_event(const Event) override {
+				sd_login_monitor_flush(monitor);
+				Logger::String{"Login sessions changed, dropping cached user bus addresses"}.trace("d-bus");
+				UserBusAddresses::getInstance().clear();
+			}
+
+		public:
+			Monitor() : MainLoop::Handler(-1,(MainLoop::Handler::Event) POLLIN) {
+				if(sd_login_monitor_new("session",&monitor) < 0) {
+					monitor = nullptr;
+					return;
+				}
+				set(sd_login_monitor_get_fd(monitor));
+				enable();
+			}
+
+			~Monitor() {
+				if(monitor) {
+					disable();
+					sd_login_monitor_unref(monitor);
+				}
+			}
+
+		} monitor;
+#endif // HAVE_SYSTEMD
+
+		UserBusAddresses() = default;
+
+		static std::string key(uid_t uid, const char *sid) {
+			std::string key{std::to_string(uid)};
+			key += ':';
+			if(sid) {
+				key += sid;
+			}
+			return key;
+		}
+
+		/// @brief Check if the path still exists and is owned by uid.
+		static bool valid(const std::string &path, uid_t uid) {
+			struct stat st;
+			return stat(path.c_str(),&st) == 0 && st.st_uid == uid;
+		}
+
+		/// @brief Scan /proc for the processes of uid exporting DBUS_SESSION_BUS_ADDRESS.
+		/// @param entries Receives the distinct addresses found.
+		static void scan(uid_t uid, const char *sid, std::vector<Entry> &entries);
+
+	public:
+
+		static UserBusAddresses & getInstance() {
+			MainLoop::getInstance();	// The monitor needs the main loop, keep it alive longer than us.
+			static UserBusAddresses instance;
+			return instance;
+		}
+
+		void clear() {
+			lock_guard<mutex> lock(guard);
+			entries.clear();
+		}
+
+		/// @brief Forget the cached address (it was unusable).
+		/// @return false if there was no cached address.
+		bool remove(uid_t uid, const char *sid) {
+			lock_guard<mutex> lock(guard);
+			size_t count = entries.erase(key(uid,nullptr));
+			count += entries.erase(key(uid,sid));
+			return count != 0;
+		}
+
+		/// @brief Cache the address that was opened.
+		void insert(uid_t uid, const char *sid, const Entry &entry) {
+			lock_guard<mutex> lock(guard);
+			entries[key(uid,entry.shared ? nullptr : sid)] = entry;
+		}
+
+		/// @brief Get the candidate bus addresses for user/session.
+		/// @return The cached address, if still valid, or all the addresses found for the user/session.
+		std::vector<Entry> find(uid_t uid, const char *sid);
+
+	};
+
+	std::vector<UserBusAddresses::Entry> UserBusAddresses::find(uid_t uid, const char *sid) {
+
+		std::vector<Entry> candidates;
+
+		{
+			// The systemd user bus doesn't depend on the session, it's cached by uid only.
+			lock_guard<mutex> lock(guard);
+			for(const std::string &k : { key(uid,nullptr), key(uid,sid) }) {
+				auto it = entries.find(k);
+				if(it != entries.end()) {
+					if(valid(it->second.path,uid)) {
+						candidates.push_back(it->second);
+						return candidates;
+					}
+					Logger::String{"Cached bus address '",it->second.address.c_str(),"' is no longer valid"}.trace("d-bus");
+					entries.erase(it);
+				}
+			}
+		}
+
+		// Try the systemd user bus first, it's shared by all sessions of the user.
+		{
+			Entry entry;
+			entry.path = "/run/user/";
+			entry.path += std::to_string(uid);
+			entry.path += "/bus";
+
+			struct stat st;
+			if(stat(entry.path.c_str(),&st) == 0 && S_ISSOCK(st.st_mode) && st.st_uid == uid) {
+				entry.address = "unix:path=";
+				entry.address += entry.path;
+				entry.shared = true;
+				candidates.push_back(entry);
+			}
+		}
+
+		// Then the addresses exported by the user processes.
+		scan(uid,sid,candidates);
+
+		return candidates;
+
+	}
+
+	void UserBusAddresses::scan(uid_t uid, const char *sid, std::vector<Entry> &entries) {
+
+		/// @brief File on /proc/[PID]/environ
 
 		class Environ {
 		private:
@@ -81,8 +229,6 @@
 
 		};
 
-		DBusConnection *connection = nullptr;
-
 		// https://stackoverflow.com/questions/6496847/access-another-users-d-bus-session
 		DIR * dir = opendir("/proc");
         if(!dir) {
@@ -92,7 +238,7 @@
         try {
 
 			struct dirent *ent;
-			while((ent=readdir(dir))!=NULL && !connection) {
+			while((ent=readdir(dir))!=NULL) {
 
 				Environ environ(dir,ent->d_name);
 
@@ -105,8 +251,8 @@
 				if(sid && *sid) {
 					char *sname = nullptr;
 
-					// Reject pids without session.
-					if(sd_pid_get_session(atoi(ent->d_name), &sname) == -ENODATA)
+					// Reject pids without session or already gone.
+					if(sd_pid_get_session(atoi(ent->d_name), &sname) < 0 || !sname)
 						continue;
 
 					// Test if it's the required session.
@@ -125,40 +271,22 @@
 					for(const char *ptr = text.c_str(); *ptr; ptr += (strlen(ptr)+1)) {
 						if(strncmp(ptr,"DBUS_SESSION_BUS_ADDRESS",24) == 0 && ptr[24] == '=') {
 
-							// Found session address, try to open it.
-
-							// Get an static lock guard to avoid another change
-							static mutex guard;
-							lock_guard<mutex> lock(guard);
-
-							// Save application EUID and switch to required UID.
-							uid_t saved_uid = geteuid();
-							if(seteuid(uid) < 0) {
-
-								cerr << "dbus\tCan't set efective UID: " << strerror(errno) << endl;
-
-							} else {
-
-								DBusError err;
-								dbus_error_init(&err);
-
-								ptr += 25;
-
-								connection = dbus_connection_open_private(ptr, &err);
-								if(dbus_error_is_set(&err)) {
-									clog << "dbus\tError '" << err.message << "' opening BUS " << ptr << endl;
-									dbus_error_free(&err);
-									connection = nullptr;
+							// Found session address, the entry is valid while the process exists.
+							const char *address = ptr+25;
+							bool known = false;
+							for(const Entry &entry : entries) {
+								if(entry.address == address) {
+									known = true;
+									break;
 								}
-#ifdef DEBUG
-								else {
-									cout << "dbus\tGot user connection on " << ptr << endl;
-								}
-#endif // DEBUG
-
-								// Restore to saved UID.
-								seteuid(saved_uid);
+							}
 
+							if(!known) {
+								Entry entry;
+								entry.address = address;
+								entry.path = "/proc/";
+								entry.path += ent->d_name;
+								entries.push_back(entry);
 							}
 							break;
 						}
@@ -176,6 +304,73 @@
 
 		closedir(dir);
 
+	}
+
+	/// @brief Open the bus address with the user's effective UID.
+	/// @return The private connection, nullptr if the address is not usable.
+	static DBusConnection * OpenUserBus(uid_t uid, const char *address) {
+
+		// Get an static lock guard to avoid another change
+		static mutex guard;
+		lock_guard<mutex> lock(guard);
+
+		// Save application EUID and switch to required UID.
+		uid_t saved_uid = geteuid();
+		if(seteuid(uid) < 0) {
+			cerr << "dbus\tCan't set efective UID: " << strerror(errno) << endl;
+			return nullptr;
+		}
+
+		DBusError err;
+		dbus_error_init(&err);
+
+		DBusConnection *connection = dbus_connection_open_private(address, &err);
+		if(dbus_error_is_set(&err)) {
+			clog << "dbus\tError '" << err.message << "' opening BUS " << address << endl;
+			dbus_error_free(&err);
+			connection = nullptr;
+		}
+#ifdef DEBUG
+		else {
+			cout << "dbus\tGot user connection on " << address << endl;
+		}
+#endif // DEBUG
+
+		// Restore to saved UID.
+		seteuid(saved_uid);
+
+		return connection;
+
+	}
+
+	static DBusConnection * UserConnectionFactory(uid_t uid, const char *sid) {
+
+		Logger::String{"Opening connection to user '",uid,"'"}.trace("d-bus");
+
+		DBusConnection *connection = nullptr;
+		UserBusAddresses &addresses = UserBusAddresses::getInstance();
+
+		// Try the cached address, rescan once if it's not usable.
+		for(size_t attempt = 0; attempt < 2 && !connection; attempt++) {
+
+			for(const auto &entry : addresses.find(uid,sid)) {
+
+				connection = OpenUserBus(uid,entry.address.c_str());
+				if(connection) {
+					Logger::String{"Got bus address '",entry.address.c_str(),"' for user '",uid,"'"}.trace("d-bus");
+					addresses.insert(uid,sid,entry);
+					break;
+				}
+
+			}
+
+			if(!(connection || addresses.remove(uid,sid))) {
+				// Nothing was cached, all the addresses found were tried.
+				break;
+			}
+
+		}
+
         if(!connection) {
 			throw system_error(ENOENT,system_category(),"Unable to find D-Bus session for requested user");
         }
@@ -176,11 +176,10 @@
 		return;
 	}
 
-	DBusConnection *c = connection->connection();
-	dbus_connection_ref(c);
-	while (dbus_connection_get_dispatch_status(c) == DBUS_DISPATCH_DATA_REMAINS)
-        dbus_connection_dispatch(c);
-	dbus_connection_unref(c);
+	// Dispatch within the budget, leave the remaining messages for the next wakeup.
+	if(connection->dispatch()) {
+		connection->wakeup();
+	}
 
  }
 
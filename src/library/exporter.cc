@@ -0,0 +1,648 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements DBus::Exporter.
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <dbus/dbus.h>
+ #include <udjat/agent/abstract.h>
+ #include <udjat/tools/activatable.h>
+ #include <udjat/tools/logger.h>
+ #include <udjat/tools/dbus/exporter.h>
+ #include <udjat/tools/dbus/request.h>
+ #include <udjat/tools/dbus/signal.h>
+ #include <udjat/tools/dbus/value.h>
+ #include <algorithm>
+ #include <cctype>
+ #include <atomic>
+ #include <mutex>
+ #include <stdexcept>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	const char * DBus::Exporter::interface = "br.eti.werneck.udjat.agent";
+
+	/// @brief Names of the exported properties.
+	static const char * properties[] = { "name", "path", "value", "state", "summary", "level" };
+
+	static constexpr size_t PropertyCount = sizeof(properties) / sizeof(properties[0]);
+
+	/// @brief Bit mask with all the properties, one bit by property index.
+	static constexpr unsigned int AllProperties = (1 << PropertyCount) - 1;
+
+	/// @brief Get the properties changed by the agent events.
+	static unsigned int changes(Abstract::Agent::Event event) noexcept {
+
+		unsigned int properties = 0;
+
+		if(event & Abstract::Agent::VALUE_CHANGED) {
+			properties |= (1 << 2);					// value
+		}
+
+		if(event & Abstract::Agent::STATE_CHANGED) {
+			properties |= (1 << 3)|(1 << 4)|(1 << 5);	// state, summary and level
+		}
+
+		if(event & Abstract::Agent::LEVEL_CHANGED) {
+			properties |= (1 << 5);					// level
+		}
+
+		return properties;
+
+	}
+
+	/// @brief Create an empty method return, for copying on the replies.
+	static DBusMessage * prototype() {
+
+		DBusMessage *message = dbus_message_new(DBUS_MESSAGE_TYPE_METHOD_RETURN);
+		if(!message) {
+			throw runtime_error("Can't create d-bus reply");
+		}
+
+		dbus_message_set_no_reply(message,TRUE);
+		return message;
+
+	}
+
+	/// @brief Agent properties, read once for all the replies.
+	struct Snapshot {
+
+		std::shared_ptr<Abstract::Agent> agent;
+		std::shared_ptr<Abstract::State> state;
+		DBus::Value value;
+
+		/// @param properties The properties to read, the agent value is read only if required.
+		Snapshot(std::shared_ptr<Abstract::Agent> a, unsigned int properties) : agent{a}, state{a->state()} {
+			if(properties & (1 << 2)) {
+				agent->get(value);
+			}
+		}
+
+		/// @brief Add property value on iter, as a variant.
+		void get(DBusMessageIter *iter, size_t property) const {
+
+			switch(property) {
+			case 0:	// name
+				DBus::Value{DBUS_TYPE_STRING,agent->name()}.variant(iter);
+				break;
+
+			case 1:	// path
+				DBus::Value{DBUS_TYPE_STRING,agent->path().c_str()}.variant(iter);
+				break;
+
+			case 2:	// value
+				try {
+
+					value.variant(iter);
+
+				} catch(const std::exception &) {
+
+					// Not a d-bus type, export the formatted value.
+					DBus::Value{DBUS_TYPE_STRING,agent->to_string().c_str()}.variant(iter);
+
+				}
+				break;
+
+			case 3:	// state
+				DBus::Value{DBUS_TYPE_STRING,state->name()}.variant(iter);
+				break;
+
+			case 4:	// summary
+				DBus::Value{DBUS_TYPE_STRING,state->summary()}.variant(iter);
+				break;
+
+			case 5:	// level
+				{
+					DBus::Value level;
+					level.set((unsigned int) state->level());
+					level.variant(iter);
+				}
+				break;
+
+			}
+
+		}
+
+		/// @brief Add the properties on iter, as a{sv}.
+		/// @param mask Bit mask of the properties to add.
+		void select(DBusMessageIter *iter, unsigned int mask) const {
+
+			DBusMessageIter array;
+			if(!dbus_message_iter_open_container(iter,DBUS_TYPE_ARRAY,"{sv}",&array)) {
+				throw runtime_error("Can't open d-bus array");
+			}
+
+			for(size_t property = 0; property < PropertyCount; property++) {
+
+				if(!(mask & (1 << property))) {
+					continue;
+				}
+
+				DBusMessageIter entry;
+				if(!dbus_message_iter_open_container(&array,DBUS_TYPE_DICT_ENTRY,NULL,&entry)) {
+					throw runtime_error("Can't open d-bus dictionary entry");
+				}
+
+				dbus_message_iter_append_basic(&entry,DBUS_TYPE_STRING,&properties[property]);
+				get(&entry,property);
+
+				dbus_message_iter_close_container(&array,&entry);
+
+			}
+
+			dbus_message_iter_close_container(iter,&array);
+
+		}
+
+	};
+
+	class DBus::Exporter::Object : public std::enable_shared_from_this<DBus::Exporter::Object> {
+	private:
+
+		std::mutex guard;
+
+		/// @brief Marshalled replies, nullptr when the property has changed.
+		struct {
+			DBusMessage *all = nullptr;
+			DBusMessage *values[PropertyCount] = {};
+		} cache;
+
+		/// @brief Properties changed since the last PropertiesChanged signal.
+		unsigned int dirty = 0;
+
+		/// @brief Release the marshalled replies of the properties, must be called with the guard locked.
+		void release(unsigned int properties = AllProperties) noexcept {
+
+			if(cache.all) {
+				dbus_message_unref(cache.all);
+				cache.all = nullptr;
+			}
+
+			for(size_t property = 0; property < PropertyCount; property++) {
+				if((properties & (1 << property)) && cache.values[property]) {
+					dbus_message_unref(cache.values[property]);
+					cache.values[property] = nullptr;
+				}
+			}
+
+		}
+
+		/// @brief Get the agent, throw if it's gone.
+		std::shared_ptr<Abstract::Agent> owner() const {
+			auto agent = this->agent.lock();
+			if(!agent) {
+				throw runtime_error("The agent is no longer available");
+			}
+			return agent;
+		}
+
+		/// @brief Marshall the property reply from the snapshot, must be called with the guard locked.
+		void build(const Snapshot &snapshot, size_t property) {
+
+			DBusMessage *message = prototype();
+
+			try {
+
+				DBusMessageIter iter;
+				dbus_message_iter_init_append(message,&iter);
+				snapshot.get(&iter,property);
+
+			} catch(...) {
+
+				dbus_message_unref(message);
+				throw;
+
+			}
+
+			cache.values[property] = message;
+
+		}
+
+		/// @brief Agent event listener, marks the properties changed by the event.
+		class Listener : public Udjat::Activatable {
+		private:
+			std::weak_ptr<Object> object;
+			unsigned int properties;
+
+		public:
+			Listener(std::shared_ptr<Abstract::Agent> agent, std::shared_ptr<Object> o, Abstract::Agent::Event event)
+				: Udjat::Activatable{agent->name()}, object{o}, properties{changes(event)} {
+			}
+
+			bool activate() noexcept override {
+				auto object = this->object.lock();
+				if(object) {
+					object->changed(properties);
+				}
+				return true;
+			}
+
+		};
+
+		/// @brief Listeners of the agent events.
+		std::vector<std::shared_ptr<Udjat::Activatable>> listeners;
+
+		/// @brief Check the interface argument.
+		/// @return true if the interface is empty or the agent interface.
+		static bool check(Request &request, std::string_view name) noexcept {
+
+			if(name.empty() || name == Exporter::interface) {
+				return true;
+			}
+
+			request.failed(DBUS_ERROR_UNKNOWN_INTERFACE,"No such interface");
+			return false;
+
+		}
+
+	public:
+
+		/// @brief The object path.
+		const std::string path;
+
+		const std::weak_ptr<Abstract::Agent> agent;
+
+		/// @brief True if waiting on the signal batch.
+		std::atomic<bool> queued{false};
+
+		const std::shared_ptr<Batch> batch;
+
+		Object(std::shared_ptr<Abstract::Agent> a, std::string p, std::shared_ptr<Batch> b)
+			: path{p}, agent{a}, batch{b} {
+		}
+
+		~Object() {
+			release();
+		}
+
+		/// @brief Listen to the agent events, one listener for each event to know the changed properties.
+		void listen(std::shared_ptr<Abstract::Agent> agent) {
+
+			try {
+
+				for(Abstract::Agent::Event event : { Abstract::Agent::VALUE_CHANGED, Abstract::Agent::STATE_CHANGED, Abstract::Agent::LEVEL_CHANGED }) {
+					auto listener = make_shared<Listener>(agent,shared_from_this(),event);
+					listeners.push_back(listener);
+					agent->push_back(event,listener);
+				}
+
+			} catch(...) {
+
+				unlisten();
+				throw;
+
+			}
+
+		}
+
+		/// @brief Stop listening to the agent events.
+		void unlisten() noexcept {
+
+			auto agent = this->agent.lock();
+			if(agent) {
+				for(auto &listener : listeners) {
+					agent->remove(listener);
+				}
+			}
+			listeners.clear();
+
+		}
+
+		/// @brief The properties have changed, drop their replies and queue the signal.
+		void changed(unsigned int properties) noexcept;
+
+		/// @brief Rebuild the replies of the changed properties and add the PropertiesChanged signal to batch.
+		void changed(SignalBatch &signals) {
+
+			queued = false;
+
+			Signal signal{DBUS_INTERFACE_PROPERTIES,"PropertiesChanged",path.c_str()};
+
+			{
+				lock_guard<mutex> lock(guard);
+
+				unsigned int properties = dirty;
+				if(!properties) {
+					return;
+				}
+
+				Snapshot snapshot{owner(),properties};
+
+				// The replies of the changed properties, from the same snapshot as the signal.
+				for(size_t property = 0; property < PropertyCount; property++) {
+					if((properties & (1 << property)) && !cache.values[property]) {
+						build(snapshot,property);
+					}
+				}
+
+				DBusMessageIter iter;
+				dbus_message_iter_init_append(signal.dbus_message(),&iter);
+				dbus_message_iter_append_basic(&iter,DBUS_TYPE_STRING,&Exporter::interface);
+				snapshot.select(&iter,properties);
+
+				// No invalidated properties, the values are on the signal.
+				DBusMessageIter invalidated;
+				dbus_message_iter_open_container(&iter,DBUS_TYPE_ARRAY,"s",&invalidated);
+				dbus_message_iter_close_container(&iter,&invalidated);
+
+				dirty = 0;
+
+			}
+
+			signals.push_back(signal);
+
+		}
+
+		/// @brief Answer org.freedesktop.DBus.Properties.Get(s interface, s property).
+		void get(Request &request) {
+
+			auto [name, property] = request.unpack<std::string_view,std::string_view>();
+
+			if(!check(request,name)) {
+				return;
+			}
+
+			for(size_t ix = 0; ix < PropertyCount; ix++) {
+
+				if(property == properties[ix]) {
+					lock_guard<mutex> lock(guard);
+					if(!cache.values[ix]) {
+						build(Snapshot{owner(),(unsigned int) (1 << ix)},ix);
+					}
+					request.send(cache.values[ix]);
+					return;
+				}
+
+			}
+
+			request.failed(DBUS_ERROR_UNKNOWN_PROPERTY,"No such property");
+
+		}
+
+		/// @brief Answer org.freedesktop.DBus.Properties.GetAll(s interface).
+		void get_all(Request &request) {
+
+			auto [name] = request.unpack<std::string_view>();
+
+			if(check(request,name)) {
+				get_agent(request);
+			}
+
+		}
+
+		/// @brief Answer br.eti.werneck.udjat.agent.get() and info(), with the same reply of GetAll.
+		void get_agent(Request &request) {
+
+			lock_guard<mutex> lock(guard);
+
+			if(!cache.all) {
+
+				DBusMessage *message = prototype();
+
+				try {
+
+					DBusMessageIter iter;
+					dbus_message_iter_init_append(message,&iter);
+					Snapshot{owner(),AllProperties}.select(&iter,AllProperties);
+
+				} catch(...) {
+
+					dbus_message_unref(message);
+					throw;
+
+				}
+
+				cache.all = message;
+
+			}
+
+			request.send(cache.all);
+
+		}
+
+	};
+
+	class DBus::Exporter::Batch : public std::enable_shared_from_this<DBus::Exporter::Batch> {
+	private:
+
+		std::mutex guard;
+
+		/// @brief The connection, not referenced; the exported methods keep the batch alive.
+		std::weak_ptr<Abstract::DBus::Connection> connection;
+
+		/// @brief Objects changed since the last flush.
+		std::vector<std::shared_ptr<Object>> objects;
+
+	public:
+		Batch(std::shared_ptr<Abstract::DBus::Connection> c) : connection{c} {
+		}
+
+		/// @brief Queue object, the signals are emitted on the next main loop iteration.
+		void push_back(std::shared_ptr<Object> object) {
+
+			auto connection = this->connection.lock();
+			if(!connection) {
+				return;
+			}
+
+			{
+				lock_guard<mutex> lock(guard);
+				objects.push_back(object);
+				if(objects.size() > 1) {
+					// Already scheduled.
+					return;
+				}
+			}
+
+			connection->post([batch=shared_from_this()](){
+				batch->flush();
+			});
+
+		}
+
+		/// @brief Emit the PropertiesChanged signals of the queued objects.
+		void flush() noexcept {
+
+			std::vector<std::shared_ptr<Object>> changed;
+			{
+				lock_guard<mutex> lock(guard);
+				changed.swap(objects);
+			}
+
+			auto connection = this->connection.lock();
+			if(!connection || changed.empty()) {
+				return;
+			}
+
+			SignalBatch signals;
+
+			for(auto &object : changed) {
+
+				try {
+
+					object->changed(signals);
+
+				} catch(const std::exception &e) {
+
+					Logger::String{object->path.c_str(),": ",e.what()}.error("d-bus");
+
+				}
+
+			}
+
+			try {
+
+				connection->enqueue(signals);
+
+			} catch(const std::exception &e) {
+
+				Logger::String{"Can't emit PropertiesChanged: ",e.what()}.error(connection->name());
+
+			}
+
+		}
+
+	};
+
+	void DBus::Exporter::Object::changed(unsigned int properties) noexcept {
+
+		{
+			lock_guard<mutex> lock(guard);
+			release(properties);
+			dirty |= properties;
+		}
+
+		if(!queued.exchange(true)) {
+			try {
+				batch->push_back(shared_from_this());
+			} catch(const std::exception &e) {
+				queued = false;
+				Logger::String{path.c_str(),": ",e.what()}.error("d-bus");
+			}
+		}
+
+	}
+
+	DBus::Exporter::Exporter(std::shared_ptr<Abstract::DBus::Connection> c, std::shared_ptr<Abstract::Agent> agent, const char *p)
+		: connection{c}, prefix{p}, batch{make_shared<Batch>(c)} {
+
+		while(!prefix.empty() && prefix.back() == '/') {
+			prefix.pop_back();
+		}
+
+		push_back(agent);
+
+		Logger::String{"Exporting ",objects.size()," agent(s) as d-bus objects"}.trace(connection->name());
+
+	}
+
+	DBus::Exporter::~Exporter() {
+
+		for(auto &object : objects) {
+
+			connection->unregister(object->path.c_str(),DBUS_INTERFACE_PROPERTIES);
+			connection->unregister(object->path.c_str(),interface);
+			object->unlisten();
+
+		}
+
+	}
+
+	std::string DBus::Exporter::path(const char *agentpath) const {
+
+		static const char hex[] = "0123456789abcdef";
+
+		std::string path{prefix};
+
+		for(const char *ptr = agentpath; *ptr; ptr++) {
+
+			if(*ptr == '/') {
+				// No empty segments.
+				if(path.empty() || path.back() != '/') {
+					path += '/';
+				}
+			} else if(isalnum((unsigned char) *ptr)) {
+				path += *ptr;
+			} else {
+				// Including the '_', or 'a-' and 'a_2d' would be the same object.
+				path += '_';
+				path += hex[(((unsigned char) *ptr) >> 4) & 0x0F];
+				path += hex[((unsigned char) *ptr) & 0x0F];
+			}
+
+		}
+
+		while(path.size() > 1 && path.back() == '/') {
+			path.pop_back();
+		}
+
+		if(path.empty()) {
+			path = "/";
+		} else if(path[0] != '/') {
+			path.insert(0,1,'/');
+		}
+
+		return path;
+
+	}
+
+	void DBus::Exporter::push_back(std::shared_ptr<Abstract::Agent> agent) {
+
+		std::string path{this->path(agent->path().c_str())};
+
+		auto exported = std::find_if(objects.begin(),objects.end(),[&path](const std::shared_ptr<Object> &object){
+			return object->path == path;
+		});
+
+		if(exported == objects.end()) {
+
+			auto object = make_shared<Object>(agent,path,batch);
+
+			connection->register_method(path.c_str(),DBUS_INTERFACE_PROPERTIES,"Get",[object](std::shared_ptr<Request> request){
+				object->get(*request);
+			});
+
+			connection->register_method(path.c_str(),DBUS_INTERFACE_PROPERTIES,"GetAll",[object](std::shared_ptr<Request> request){
+				object->get_all(*request);
+			});
+
+			// The agent methods called by the test scripts.
+			for(const char *member : { "get", "info" }) {
+				connection->register_method(path.c_str(),interface,member,[object](std::shared_ptr<Request> request){
+					object->get_agent(*request);
+				});
+			}
+
+			object->listen(agent);
+			objects.push_back(object);
+
+		}
+
+		for(auto child : *agent) {
+			push_back(child);
+		}
+
+	}
+
+ }
@@ -20,14 +20,15 @@
  #include <config.h>
  #include <udjat/defs.h>
  #include <udjat/tools/dbus/interface.h>
+ #include <udjat/tools/dbus/connection.h>
  #include <udjat/tools/string.h>
 
  namespace Udjat {
 
-	DBus::Interface::Interface(const char *n) : std::string{n}, type{"signal"} {
+	DBus::Interface::Interface(const char *n) : std::string{n}, type{"signal"}, hashvalue{DBus::hash(n)} {
 	}
 
-	DBus::Interface::Interface(const XML::Node &node) : std::string{String{node,"dbus-interface"}}, type{"signal"} {
+	DBus::Interface::Interface(const XML::Node &node) : std::string{String{node,"dbus-interface"}}, type{"signal"}, hashvalue{DBus::hash(c_str())} {
 	}
 
 	DBus::Interface::~Interface() {
@@ -42,19 +43,65 @@
 	}
 
 	Udjat::DBus::Member & DBus::Interface::push_back(const XML::Node &node,const std::function<void(Udjat::DBus::Message & message)> &callback) {
+		if(connection) {
+			return connection->insert([&]() -> Udjat::DBus::Member & {
+				return members.emplace_back(node,callback);
+			});
+		}
 		return members.emplace_back(node,callback);
 	}
 
 	Udjat::DBus::Member & DBus::Interface::emplace_back(const char *member, const std::function<void(Udjat::DBus::Message & message)> &callback) {
+		if(connection) {
+			return connection->insert([&]() -> Udjat::DBus::Member & {
+				return members.emplace_back(member,callback);
+			});
+		}
 		return members.emplace_back(member,callback);
 	}
 
+	Udjat::DBus::Member & DBus::Interface::emplace_back(const char *member, const Member::Filter &filter, const std::function<void(Udjat::DBus::Message & message)> &callback) {
+		if(connection) {
+			return connection->insert([&]() -> Udjat::DBus::Member & {
+				return members.emplace_back(member,filter,callback);
+			});
+		}
+		return members.emplace_back(member,filter,callback);
+	}
+
+	Udjat::DBus::Member & DBus::Interface::emplace_back(const char *member, const Member::Filter &filter, const Member::Dispatch &dispatch, const std::function<void(Udjat::DBus::Message & message)> &callback) {
+		if(connection) {
+			return connection->insert([&]() -> Udjat::DBus::Member & {
+				return members.emplace_back(member,filter,dispatch,callback);
+			});
+		}
+		return members.emplace_back(member,filter,dispatch,callback);
+	}
+
+	bool DBus::Interface::contains(const Udjat::DBus::Member &member) const noexcept {
+		for(const auto &m : members) {
+			if(&m == &member) {
+				return true;
+			}
+		}
+		return false;
+	}
+
 	void DBus::Interface::remove(const Udjat::DBus::Member &member) {
 		members.remove_if([&member](Udjat::DBus::Member &m){
 			return &m == &member;
 		});
 	}
 
+	void DBus::Interface::splice(const Udjat::DBus::Member &member, std::list<Udjat::DBus::Member> &to) {
+		for(auto it = members.begin(); it != members.end(); it++) {
+			if(&(*it) == &member) {
+				to.splice(to.end(),members,it);
+				return;
+			}
+		}
+	}
+
  }
 
 
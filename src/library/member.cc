@@ -26,27 +26,233 @@
  #include <udjat/tools/dbus/member.h>
  #include <udjat/tools/string.h>
  #include <udjat/tools/logger.h>
+ #include <private/queue.h>
+ #include <private/owner.h>
 
  using namespace std;
 
  namespace Udjat {
 
-	DBus::Member::Member(const char *name,const std::function<void(Message & message)> &c) : string{name}, callback{c} {
+	DBus::Member::Filter::Filter(const XML::Node &node)
+		: path{String{node,"dbus-path"}}, path_namespace{String{node,"dbus-path-namespace"}}, sender{String{node,"dbus-sender"}} {
+
+		for(size_t arg = 0; arg <= DBUS_MAXIMUM_MATCH_RULE_ARG_NUMBER; arg++) {
+			String value{node,(string{"dbus-arg"} + std::to_string(arg)).c_str()};
+			if(!value.empty()) {
+				args.resize(arg+1);
+				args[arg] = value;
+			}
+		}
+
+	}
+
+	DBus::Member::Dispatch::Dispatch(const XML::Node &node)
+		: window{node.attribute("dbus-window").as_uint(0)}, limit{node.attribute("dbus-queue-size").as_uint(128)} {
+
+		String value{node,"dbus-dispatch","inline"};
+
+		if(!strcasecmp(value.c_str(),"pool")) {
+			mode = Pool;
+		} else if(!strcasecmp(value.c_str(),"serial")) {
+			mode = Serial;
+		} else if(strcasecmp(value.c_str(),"inline")) {
+			throw runtime_error(String{"Unexpected dispatch mode '",value.c_str(),"'"});
+		}
+
+		value = String{node,"dbus-coalesce","none"};
+
+		if(!strcasecmp(value.c_str(),"latest")) {
+			coalesce = Latest;
+		} else if(!strcasecmp(value.c_str(),"merge")) {
+			coalesce = Merge;
+		} else if(strcasecmp(value.c_str(),"none")) {
+			throw runtime_error(String{"Unexpected coalesce mode '",value.c_str(),"'"});
+		}
+
+		if(!limit) {
+			limit = 1;
+		}
+
+	}
+
+	DBus::Member::Member(const Member &src)
+		: string{src}, callback{src.callback}, hashvalue{src.hashvalue}, filter{src.filter}, dispatch{src.dispatch},
+			owner{src.owner}, queue{QueueFactory(src.c_str(),src.dispatch,src.callback)}, active{src.subscribed()} {
+	}
+
+	DBus::Member::Member(const char *name,const std::function<void(Message & message)> &c) : string{name}, callback{c}, hashvalue{DBus::hash(name)} {
 		Logger::String{"Watching '",c_str(),"'"}.trace("d-bus");
 	}
 
-	DBus::Member::Member(const XML::Node &node,const std::function<void(Message & message)> &callback) : Member{String{node,"dbus-member"}.c_str(),callback} {
+	DBus::Member::Member(const char *name,const Filter &f,const std::function<void(Message & message)> &c) : Member{name,f,Dispatch{},c} {
+	}
+
+	DBus::Member::Member(const char *name,const Filter &f,const Dispatch &d,const std::function<void(Message & message)> &c)
+		: string{name}, callback{c}, hashvalue{DBus::hash(name)}, filter{f}, dispatch{d}, queue{QueueFactory(name,d,c)} {
 		Logger::String{"Watching '",c_str(),"'"}.trace("d-bus");
 	}
 
+	DBus::Member::Member(const XML::Node &node,const std::function<void(Message & message)> &callback) : Member{String{node,"dbus-member"}.c_str(),Filter{node},Dispatch{node},callback} {
+	}
+
 	DBus::Member::~Member() {
+		if(queue) {
+			queue->stop();
+		}
 		Logger::String{"Unwatching '",c_str(),"'"}.trace("d-bus");
 	}
 
+	void DBus::Member::call(DBusMessage *message) const {
+
+		if(queue) {
+			queue->push(message);
+			return;
+		}
+
+		Message msg(message);
+		callback(msg);
+
+	}
+
 	bool DBus::Member::operator==(const char *name) const noexcept {
 		return strcasecmp(name,c_str()) == 0;
 	}
 
- }
+	/// @brief Append a quoted key to the match rule.
+	static void append_key(std::string &rule, const char *key, const std::string &value) {
+
+		if(value.empty()) {
+			return;
+		}
+
+		rule += ',';
+		rule += key;
+		rule += "='";
+
+		// Single quotes can't be escaped inside a quoted value, close, escape and reopen.
+		for(const char *ptr = value.c_str(); *ptr; ptr++) {
+			if(*ptr == '\'') {
+				rule += "'\\''";
+			} else {
+				rule += *ptr;
+			}
+		}
+
+		rule += '\'';
+
+	}
+
+	std::string DBus::Member::rule(const char *interface) const {
+
+		std::string rule{"type='signal'"};
+
+		append_key(rule,"interface",interface);
+		append_key(rule,"member",*this);
+		append_key(rule,"sender",filter.sender);
+		append_key(rule,"path",filter.path);
+		append_key(rule,"path_namespace",filter.path_namespace);
+
+		for(size_t arg = 0; arg < filter.args.size(); arg++) {
+			append_key(rule,(string{"arg"} + std::to_string(arg)).c_str(),filter.args[arg]);
+		}
+
+		return rule;
+
+	}
+
+	bool DBus::Member::matches(DBusMessage *message) const noexcept {
+
+		// Other subscriptions can be wider than ours, check the keys known locally.
+
+		if(owner && !owner->is(dbus_message_get_sender(message))) {
+			// Same path and interface from another peer.
+			return false;
+		}
+
+		if(!(filter.path.empty() && filter.path_namespace.empty())) {
+
+			const char *path = dbus_message_get_path(message);
+			if(!path) {
+				return false;
+			}
+
+			if(!filter.path.empty() && strcmp(path,filter.path.c_str())) {
+				return false;
+			}
+
+			if(!filter.path_namespace.empty()) {
+				size_t length = filter.path_namespace.size();
+				if(strncmp(path,filter.path_namespace.c_str(),length)) {
+					return false;
+				}
+				if(path[length] && path[length] != '/' && filter.path_namespace != "/") {
+					return false;
+				}
+			}
+
+		}
+
+		if(!filter.args.empty()) {
+
+			DBusMessageIter iter;
+			bool valid = dbus_message_iter_init(message,&iter);
+
+			for(const std::string &arg : filter.args) {
+
+				if(!valid) {
+					return false;
+				}
+
+				if(!arg.empty()) {
+
+					if(dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_STRING) {
+						return false;
+					}
+
+					const char *value = nullptr;
+					dbus_message_iter_get_basic(&iter,&value);
+					if(strcmp(value,arg.c_str())) {
+						return false;
+					}
+
+				}
+
+				valid = dbus_message_iter_next(&iter);
 
+			}
 
+		}
+
+		return true;
+
+	}
+
+ 	void DBus::Member::Owner::set(const char *unique, dbus_uint32_t serial) noexcept {
+
+		lock_guard<mutex> lock(guard);
+
+		if(serial ? (serial <= this->serial) : resolved) {
+			return;
+		}
+
+		this->unique = (unique ? unique : "");
+		this->serial = serial;
+		resolved = true;
+
+		Logger::String{"'",name.c_str(),"' is owned by '",this->unique.c_str(),"'"}.trace("d-bus");
+
+	}
+
+	bool DBus::Member::Owner::is(const char *sender) const noexcept {
+
+		lock_guard<mutex> lock(guard);
+
+		if(!resolved) {
+			return true;
+		}
+
+		return sender && unique == sender;
+
+	}
+
+ }
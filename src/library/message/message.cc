@@ -92,13 +92,101 @@
 		return dbus_message_iter_next(&message.iter);
 	}
 
+	DBus::Message & DBus::Message::push_back(const DBus::Value &value) {
+		value.get(&message.iter);
+		return *this;
+	}
+
+	DBus::Message & DBus::Message::push_back(const char *value) {
+		return pack(value);
+	}
+
+	DBus::Message & DBus::Message::push_back(const bool value) {
+		return pack(value);
+	}
+
+	DBus::Message & DBus::Message::push_back(const int16_t value) {
+		return pack(value);
+	}
+
+	DBus::Message & DBus::Message::push_back(const uint16_t value) {
+		return pack(value);
+	}
+
+	DBus::Message & DBus::Message::push_back(const int32_t value) {
+		return pack(value);
+	}
+
+	DBus::Message & DBus::Message::push_back(const uint32_t value) {
+		return pack(value);
+	}
+
+	DBus::Message & DBus::Message::push_back(const int64_t value) {
+		return pack(value);
+	}
+
+	DBus::Message & DBus::Message::push_back(const uint64_t value) {
+		return pack(value);
+	}
+
+	DBus::Message & DBus::Message::push_back(const std::vector<std::string> &elements) {
+		return pack(elements);
+	}
+
+	void DBus::Message::check(const char *expected) {
+
+		if(err.valid) {
+			throw runtime_error(err.message);
+		}
+
+		// Basic types and arrays of them are checked by type codes, without building the signature.
+		int type = dbus_message_iter_get_arg_type(&message.iter);
+
+		if(type == expected[0]) {
+
+			if(!expected[1]) {
+				return;
+			}
+
+			if(type == DBUS_TYPE_ARRAY && !expected[2] && dbus_message_iter_get_element_type(&message.iter) == expected[1]) {
+				return;
+			}
+
+		}
+
+		char *signature = dbus_message_iter_get_signature(&message.iter);
+		if(!signature) {
+			throw runtime_error("Can't get d-bus argument signature");
+		}
+
+		string current{signature};
+		dbus_free(signature);
+
+		if(current != expected) {
+			throw runtime_error(string{"Unexpected d-bus argument '"} + current + "', expecting '" + expected + "'");
+		}
+
+	}
+
 	DBus::Message & DBus::Message::pop(Value &value) {
 
 		if(err.valid) {
 			throw runtime_error(err.message);
 		}
 
-		if(value.set(&message.iter))
+		if(value.set(&message.iter,arena))
+			dbus_message_iter_next(&message.iter);
+
+		return *this;
+	}
+
+	DBus::Message & DBus::Message::borrow(Value &value) {
+
+		if(err.valid) {
+			throw runtime_error(err.message);
+		}
+
+		if(value.set(&message.iter,arena,true))
 			dbus_message_iter_next(&message.iter);
 
 		return *this;
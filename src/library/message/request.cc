@@ -0,0 +1,145 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements DBus::Request.
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/logger.h>
+ #include <udjat/tools/dbus/request.h>
+ #include <udjat/tools/dbus/value.h>
+ #include <stdexcept>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	DBus::Request::Request(DBusConnection *c, DBusMessage *message) : MessageView{message}, conn{c} {
+		dbus_connection_ref(conn);
+		dbus_message_ref(message);
+	}
+
+	DBus::Request::~Request() {
+
+		send();
+
+		if(response) {
+			dbus_message_unref(response);
+		}
+
+		dbus_message_unref((DBusMessage *) *this);
+		dbus_connection_unref(conn);
+
+	}
+
+	DBusMessageIter * DBus::Request::reply() {
+
+		if(sent) {
+			throw logic_error("The reply was already sent");
+		}
+
+		if(!response) {
+			response = dbus_message_new_method_return((DBusMessage *) *this);
+			if(!response) {
+				throw runtime_error("Can't create d-bus reply");
+			}
+			dbus_message_iter_init_append(response,&iter);
+		}
+
+		return &iter;
+
+	}
+
+	DBus::Request & DBus::Request::push_back(const Value &value) {
+		value.get(reply());
+		return *this;
+	}
+
+	void DBus::Request::failed(const char *name, const char *message) noexcept {
+
+		if(sent.exchange(true) || !expects_reply()) {
+			return;
+		}
+
+		DBusMessage *error = dbus_message_new_error((DBusMessage *) *this,name,message);
+		if(!error) {
+			Logger::String{"Can't create d-bus error reply"}.error("d-bus");
+			return;
+		}
+
+		if(!dbus_connection_send(conn,error,NULL)) {
+			Logger::String{"Can't send d-bus error reply"}.error("d-bus");
+		}
+
+		dbus_message_unref(error);
+
+	}
+
+	void DBus::Request::failed(const std::exception &e) noexcept {
+		failed(DBUS_ERROR_FAILED,e.what());
+	}
+
+	void DBus::Request::send() noexcept {
+
+		if(sent.exchange(true) || !expects_reply()) {
+			return;
+		}
+
+		if(!response) {
+			response = dbus_message_new_method_return((DBusMessage *) *this);
+			if(!response) {
+				Logger::String{"Can't create d-bus reply"}.error("d-bus");
+				return;
+			}
+		}
+
+		if(!dbus_connection_send(conn,response,NULL)) {
+			Logger::String{"Can't send d-bus reply"}.error("d-bus");
+		}
+
+	}
+
+	void DBus::Request::send(const DBusMessage *prototype) noexcept {
+
+		if(sent.exchange(true) || !expects_reply()) {
+			return;
+		}
+
+		// The copy has the header and the marshalled arguments, only the addressing is set.
+		DBusMessage *copy = dbus_message_copy(prototype);
+		if(!copy) {
+			Logger::String{"Can't create d-bus reply"}.error("d-bus");
+			return;
+		}
+
+		const char *sender = dbus_message_get_sender((DBusMessage *) *this);
+
+		if(!dbus_message_set_reply_serial(copy,serial()) || (sender && !dbus_message_set_destination(copy,sender))) {
+			Logger::String{"Can't set d-bus reply header"}.error("d-bus");
+		} else if(!dbus_connection_send(conn,copy,NULL)) {
+			Logger::String{"Can't send d-bus reply"}.error("d-bus");
+		}
+
+		dbus_message_unref(copy);
+
+	}
+
+ }
@@ -0,0 +1,91 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements DBus::MessageView.
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <udjat/tools/dbus/message.h>
+ #include <udjat/tools/dbus/view.h>
+ #include <cstring>
+ #include <stdexcept>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	DBus::MessageView::MessageView(const Message &message) noexcept : MessageView{(DBusMessage *) message} {
+	}
+
+	DBus::MessageView::Argument DBus::MessageView::operator[](size_t index) const {
+
+		for(auto it = begin(); it != end(); ++it) {
+			if(!index--) {
+				return *it;
+			}
+		}
+
+		throw out_of_range("Invalid d-bus argument index");
+
+	}
+
+	size_t DBus::MessageView::size() const noexcept {
+		size_t rc = 0;
+		for(auto it = begin(); it != end(); ++it) {
+			rc++;
+		}
+		return rc;
+	}
+
+	bool DBus::MessageView::Argument::is(const char *signature) const noexcept {
+
+		int type = dbus_message_iter_get_arg_type(&iter);
+
+		if(!signature[1]) {
+
+			if(signature[0] == DBUS_TYPE_STRING) {
+				return type == DBUS_TYPE_STRING || type == DBUS_TYPE_OBJECT_PATH || type == DBUS_TYPE_SIGNATURE;
+			}
+
+			return type == signature[0];
+		}
+
+		if(type != signature[0]) {
+			return false;
+		}
+
+		if(type == DBUS_TYPE_ARRAY && !signature[2]) {
+			return dbus_message_iter_get_element_type(&iter) == signature[1];
+		}
+
+		// Nested containers, compare the full signature.
+		char *current = dbus_message_iter_get_signature(&iter);
+		if(!current) {
+			return false;
+		}
+
+		bool rc = (strcmp(current,signature) == 0);
+		dbus_free(current);
+		return rc;
+
+	}
+
+ }
@@ -0,0 +1,356 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements DBus::Proxy.
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <dbus/dbus.h>
+ #include <udjat/tools/logger.h>
+ #include <udjat/tools/dbus/connection.h>
+ #include <udjat/tools/dbus/message.h>
+ #include <udjat/tools/dbus/proxy.h>
+ #include <cstring>
+ #include <map>
+ #include <mutex>
+ #include <shared_mutex>
+ #include <string_view>
+ #include <vector>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	class DBus::Proxy::Cache : public std::enable_shared_from_this<DBus::Proxy::Cache> {
+	private:
+
+		/// @brief The connection, not referenced; the subscription keeps the cache alive.
+		std::weak_ptr<Abstract::DBus::Connection> connection;
+
+		/// @brief Unique name of the remote object owner, the sender of the last update.
+		std::string sender;
+
+		/// @brief Serial of the last message updating each property.
+		/// @details A sender numbers its messages in order; a reply or a signal older than the
+		/// last update of a property is stale and ignored.
+		std::map<std::string,dbus_uint32_t,std::less<>> serials;
+
+		/// @brief Check the sender of an update, forget the serials if the owner has changed; must be called with the guard locked.
+		void sync(const char *name) {
+			if(name && sender != name) {
+				sender = name;
+				serials.clear();
+			}
+		}
+
+		/// @brief Check if the message is newer than the last update of the property and record it; must be called with the guard locked.
+		bool newer(const char *name, dbus_uint32_t serial) {
+
+			auto it = serials.find(std::string_view{name});
+
+			if(it == serials.end()) {
+				serials.emplace(name,serial);
+				return true;
+			}
+
+			if(it->second > serial) {
+				return false;
+			}
+
+			it->second = serial;
+			return true;
+
+		}
+
+		/// @brief Update the values from an a{sv} argument, must be called with the guard locked.
+		void update(DBusMessageIter *iter, std::shared_ptr<Value::Arena> &arena, dbus_uint32_t serial) {
+
+			DBusMessageIter entries;
+			dbus_message_iter_recurse(iter,&entries);
+
+			while(dbus_message_iter_get_arg_type(&entries) == DBUS_TYPE_DICT_ENTRY) {
+
+				DBusMessageIter entry;
+				dbus_message_iter_recurse(&entries,&entry);
+
+				const char *name = nullptr;
+				dbus_message_iter_get_basic(&entry,&name);
+				dbus_message_iter_next(&entry);
+
+				if(!newer(name,serial)) {
+					dbus_message_iter_next(&entries);
+					continue;
+				}
+
+				Value value;
+				value.set(&entry,arena);
+
+				auto it = values.find(std::string_view{name});
+				if(it == values.end()) {
+					values.emplace(name,std::move(value));
+				} else {
+					it->second = std::move(value);
+				}
+
+				dbus_message_iter_next(&entries);
+			}
+
+		}
+
+	public:
+
+		const std::string destination;
+		const std::string path;
+		const std::string interface;
+
+		mutable std::shared_mutex guard;
+
+		/// @brief Property values, by name.
+		std::map<std::string,Value,std::less<>> values;
+
+		Cache(std::shared_ptr<Abstract::DBus::Connection> c, const char *d, const char *p, const char *i)
+			: connection{c}, destination{d}, path{p}, interface{i} {
+		}
+
+		/// @brief Load the GetAll reply.
+		void load(DBusMessage *message) {
+
+			if(!dbus_message_has_signature(message,"a{sv}")) {
+				throw runtime_error(string{"Unexpected d-bus signature '"} + dbus_message_get_signature(message) + "', expecting 'a{sv}'");
+			}
+
+			DBusMessageIter iter;
+			dbus_message_iter_init(message,&iter);
+
+			std::shared_ptr<Value::Arena> arena;
+			dbus_uint32_t serial = dbus_message_get_serial(message);
+
+			unique_lock<shared_mutex> lock(guard);
+
+			sync(dbus_message_get_sender(message));
+
+			// The reply has the current set, keep only the properties changed after it.
+			for(auto it = values.begin(); it != values.end();) {
+				auto updated = serials.find(it->first);
+				if(updated == serials.end() || updated->second < serial) {
+					it = values.erase(it);
+				} else {
+					it++;
+				}
+			}
+
+			update(&iter,arena,serial);
+
+		}
+
+		/// @brief Apply PropertiesChanged(s interface, a{sv} changed, as invalidated).
+		void changed(DBusMessage *message) {
+
+			if(!dbus_message_has_signature(message,"sa{sv}as")) {
+				return;
+			}
+
+			DBusMessageIter iter;
+			dbus_message_iter_init(message,&iter);
+
+			const char *name = nullptr;
+			dbus_message_iter_get_basic(&iter,&name);
+			if(interface != name) {
+				return;
+			}
+
+			dbus_message_iter_next(&iter);
+
+			std::shared_ptr<Value::Arena> arena;
+			std::vector<std::string> invalidated;
+
+			{
+				unique_lock<shared_mutex> lock(guard);
+
+				dbus_uint32_t serial = dbus_message_get_serial(message);
+				sync(dbus_message_get_sender(message));
+
+				// Properties emitted before the last reply with them are skipped, the values are older.
+				update(&iter,arena,serial);
+				dbus_message_iter_next(&iter);
+
+				DBusMessageIter names;
+				dbus_message_iter_recurse(&iter,&names);
+
+				while(dbus_message_iter_get_arg_type(&names) == DBUS_TYPE_STRING) {
+
+					dbus_message_iter_get_basic(&names,&name);
+
+					if(newer(name,serial)) {
+
+						auto it = values.find(std::string_view{name});
+						if(it != values.end()) {
+							values.erase(it);
+						}
+
+						invalidated.emplace_back(name);
+
+					}
+
+					dbus_message_iter_next(&names);
+
+				}
+
+			}
+
+			for(const std::string &name : invalidated) {
+				fetch(name.c_str());
+			}
+
+		}
+
+		/// @brief Get the new value of an invalidated property.
+		void fetch(const char *name) {
+
+			auto connection = this->connection.lock();
+			if(!connection) {
+				return;
+			}
+
+			Udjat::DBus::Message request{
+				destination.c_str(),
+				path.c_str(),
+				DBUS_INTERFACE_PROPERTIES,
+				"Get",
+				interface.c_str(),
+				name
+			};
+
+			connection->call(request,[cache=shared_from_this(),name=std::string{name}](Udjat::DBus::Message &response) {
+
+				DBusMessageIter iter;
+
+				if(!response) {
+					Logger::String{"Can't get '",name.c_str(),"': ",response.error_message()}.warning(cache->path.c_str());
+					return;
+				}
+
+				if(!dbus_message_iter_init((DBusMessage *) response,&iter)) {
+					return;
+				}
+
+				std::shared_ptr<Value::Arena> arena;
+				Value value;
+				value.set(&iter,arena);
+
+				unique_lock<shared_mutex> lock(cache->guard);
+
+				// Ignore the reply if the property changed again or the owner is not the same.
+				const char *sender = dbus_message_get_sender((DBusMessage *) response);
+				if((sender && cache->sender != sender) || !cache->newer(name.c_str(),dbus_message_get_serial((DBusMessage *) response))) {
+					return;
+				}
+
+				cache->values[name] = std::move(value);
+
+			});
+
+		}
+
+	};
+
+	DBus::Proxy::Proxy(std::shared_ptr<Abstract::DBus::Connection> c, const char *destination, const char *path, const char *interface)
+		: connection{c}, cache{make_shared<Cache>(c,destination,path,interface)} {
+
+		// Subscribe before the GetAll, so the changes after it are not lost.
+		Udjat::DBus::Member::Filter filter;
+		filter.path = path;
+		filter.sender = destination;
+		filter.args.push_back(interface);
+
+		member = &connection->subscribe(
+			DBUS_INTERFACE_PROPERTIES,
+			"PropertiesChanged",
+			filter,
+			[cache=this->cache](Udjat::DBus::Message &message) {
+				cache->changed((DBusMessage *) message);
+			}
+		);
+
+		try {
+
+			Udjat::DBus::Message request{destination,path,DBUS_INTERFACE_PROPERTIES,"GetAll",interface};
+
+			connection->call_and_wait(request,[this](Udjat::DBus::Message &response) {
+
+				if(!response) {
+					throw runtime_error(response.error_message());
+				}
+
+				cache->load((DBusMessage *) response);
+
+			});
+
+		} catch(...) {
+
+			connection->remove(*member);
+			throw;
+
+		}
+
+	}
+
+	DBus::Proxy::~Proxy() {
+		connection->remove(*member);
+	}
+
+	const char * DBus::Proxy::destination() const noexcept {
+		return cache->destination.c_str();
+	}
+
+	const char * DBus::Proxy::path() const noexcept {
+		return cache->path.c_str();
+	}
+
+	const char * DBus::Proxy::interface() const noexcept {
+		return cache->interface.c_str();
+	}
+
+	size_t DBus::Proxy::size() const {
+		shared_lock<shared_mutex> lock(cache->guard);
+		return cache->values.size();
+	}
+
+	bool DBus::Proxy::contains(const char *name) const {
+		shared_lock<shared_mutex> lock(cache->guard);
+		return cache->values.find(std::string_view{name}) != cache->values.end();
+	}
+
+	bool DBus::Proxy::get(const char *name, Udjat::DBus::Value &value) const {
+
+		shared_lock<shared_mutex> lock(cache->guard);
+
+		auto it = cache->values.find(std::string_view{name});
+		if(it == cache->values.end()) {
+			return false;
+		}
+
+		value = it->second;
+		return true;
+
+	}
+
+ }
@@ -0,0 +1,504 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+
+/*
+ * Copyright (C) 2024 Perry Werneck <perry.werneck@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+ /**
+  * @brief Implements the queue for signal handlers running outside the connection thread.
+  */
+
+ #include <config.h>
+ #include <udjat/defs.h>
+ #include <dbus/dbus.h>
+ #include <udjat/tools/dbus/member.h>
+ #include <udjat/tools/dbus/message.h>
+ #include <udjat/tools/logger.h>
+ #include <udjat/tools/threadpool.h>
+ #include <private/queue.h>
+ #include <set>
+
+ using namespace std;
+
+ namespace Udjat {
+
+	/// @brief Enabled flag of the d-bus thread running on this thread, if any.
+	static thread_local const std::atomic<bool> *dispatching = nullptr;
+
+	/// @brief Copy the current argument, including containers.
+	static void copy(DBusMessageIter *from, DBusMessageIter *to) {
+
+		int type = dbus_message_iter_get_arg_type(from);
+
+		if(dbus_type_is_basic(type)) {
+			DBusBasicValue value;
+			dbus_message_iter_get_basic(from,&value);
+			dbus_message_iter_append_basic(to,type,&value);
+			return;
+		}
+
+		DBusMessageIter source;
+		dbus_message_iter_recurse(from,&source);
+
+		char *signature = nullptr;
+		if(type == DBUS_TYPE_VARIANT) {
+			signature = dbus_message_iter_get_signature(&source);
+		} else if(type == DBUS_TYPE_ARRAY) {
+			signature = dbus_message_iter_get_signature(from);
+		}
+
+		DBusMessageIter target;
+		dbus_message_iter_open_container(to,type,(type == DBUS_TYPE_ARRAY ? signature+1 : signature),&target);
+
+		while(dbus_message_iter_get_arg_type(&source) != DBUS_TYPE_INVALID) {
+			copy(&source,&target);
+			dbus_message_iter_next(&source);
+		}
+
+		dbus_message_iter_close_container(to,&target);
+
+		if(signature) {
+			dbus_free(signature);
+		}
+
+	}
+
+	/// @brief Get the merge key ('path' and first argument) of a 'sa{sv}as' signal.
+	/// @return false if the signal can't be merged.
+	static bool mergeable(DBusMessage *message, std::string &key) {
+
+		if(!dbus_message_has_signature(message,"sa{sv}as")) {
+			return false;
+		}
+
+		DBusMessageIter iter;
+		dbus_message_iter_init(message,&iter);
+
+		DBusBasicValue value;
+		dbus_message_iter_get_basic(&iter,&value);
+
+		const char *path = dbus_message_get_path(message);
+		key = (path ? path : "");
+		key += ' ';
+		key += value.str;
+
+		return true;
+
+	}
+
+	/// @brief Get keys from the dictionary and the string array of a 'sa{sv}as' message.
+	static void keys(DBusMessage *message, std::set<std::string> &changed, std::set<std::string> &invalidated) {
+
+		DBusMessageIter iter, array;
+		dbus_message_iter_init(message,&iter);
+		dbus_message_iter_next(&iter);
+
+		dbus_message_iter_recurse(&iter,&array);
+		while(dbus_message_iter_get_arg_type(&array) == DBUS_TYPE_DICT_ENTRY) {
+			DBusMessageIter entry;
+			DBusBasicValue value;
+			dbus_message_iter_recurse(&array,&entry);
+			dbus_message_iter_get_basic(&entry,&value);
+			changed.insert(value.str);
+			dbus_message_iter_next(&array);
+		}
+
+		dbus_message_iter_next(&iter);
+
+		dbus_message_iter_recurse(&iter,&array);
+		while(dbus_message_iter_get_arg_type(&array) == DBUS_TYPE_STRING) {
+			DBusBasicValue value;
+			dbus_message_iter_get_basic(&array,&value);
+			invalidated.insert(value.str);
+			dbus_message_iter_next(&array);
+		}
+
+	}
+
+	/// @brief Build a new signal with the keys from both messages, the newer values and serial win.
+	static DBusMessage * merge(DBusMessage *older, DBusMessage *newer) {
+
+		std::set<std::string> changed, invalidated, previous, ignored;
+		keys(newer,changed,invalidated);
+
+		DBusMessage *message = dbus_message_new_signal(
+			dbus_message_get_path(newer),
+			dbus_message_get_interface(newer),
+			dbus_message_get_member(newer)
+		);
+
+		if(!message) {
+			throw runtime_error("Can't create merged D-Bus signal");
+		}
+
+		if(dbus_message_get_sender(newer)) {
+			dbus_message_set_sender(message,dbus_message_get_sender(newer));
+		}
+
+		// Keep the newer serial, the handlers can order the updates by it (as DBus::Proxy does).
+		dbus_message_set_serial(message,dbus_message_get_serial(newer));
+
+		DBusMessageIter from, to, source, target;
+		dbus_message_iter_init_append(message,&to);
+
+		// First argument, the merge key.
+		dbus_message_iter_init(newer,&from);
+		copy(&from,&to);
+
+		// Dictionary, newer entries first then the older ones not changed or invalidated.
+		dbus_message_iter_open_container(&to,DBUS_TYPE_ARRAY,"{sv}",&target);
+
+		dbus_message_iter_next(&from);
+		dbus_message_iter_recurse(&from,&source);
+		while(dbus_message_iter_get_arg_type(&source) == DBUS_TYPE_DICT_ENTRY) {
+			copy(&source,&target);
+			dbus_message_iter_next(&source);
+		}
+
+		DBusMessageIter iter;
+		dbus_message_iter_init(older,&iter);
+		dbus_message_iter_next(&iter);
+		dbus_message_iter_recurse(&iter,&source);
+		while(dbus_message_iter_get_arg_type(&source) == DBUS_TYPE_DICT_ENTRY) {
+
+			DBusMessageIter entry;
+			DBusBasicValue value;
+			dbus_message_iter_recurse(&source,&entry);
+			dbus_message_iter_get_basic(&entry,&value);
+
+			if(!(changed.count(value.str) || invalidated.count(value.str))) {
+				copy(&source,&target);
+				previous.insert(value.str);
+			}
+
+			dbus_message_iter_next(&source);
+		}
+
+		dbus_message_iter_close_container(&to,&target);
+
+		// Invalidated keys from both, unless changed after.
+		keys(older,ignored,invalidated);
+
+		dbus_message_iter_open_container(&to,DBUS_TYPE_ARRAY,"s",&target);
+		for(const std::string &name : invalidated) {
+			if(!(changed.count(name) || previous.count(name))) {
+				const char *str = name.c_str();
+				dbus_message_iter_append_basic(&target,DBUS_TYPE_STRING,&str);
+			}
+		}
+		dbus_message_iter_close_container(&to,&target);
+
+		return message;
+
+	}
+
+	std::shared_ptr<DBus::Member::Queue> DBus::Member::QueueFactory(const char *name, const Dispatch &dispatch, const std::function<void(Message & message)> &callback) {
+
+		if(dispatch.mode == Dispatch::Inline && !dispatch.window) {
+			return std::shared_ptr<Queue>();
+		}
+
+		auto queue = make_shared<Queue>(name,dispatch,callback);
+		queue->start();
+		return queue;
+
+	}
+
+	DBus::Member::Queue::Queue(const char *n, const Dispatch &d, const std::function<void(Message & message)> &c)
+		: name{n}, dispatch{d}, callback{c} {
+	}
+
+	DBus::Member::Queue::Queue(const char *n, const Dispatch &d, const std::function<void(Message & message)> &c, const Reject &r)
+		: name{n}, dispatch{d}, callback{c}, reject{r} {
+	}
+
+	DBus::Member::Queue::~Queue() {
+		for(DBusMessage *message : messages) {
+			dbus_message_unref(message);
+		}
+	}
+
+	void DBus::Member::Queue::Timer::on_timer() {
+
+		disable();
+
+		unique_lock<mutex> lock(queue.guard);
+		queue.held = false;
+		queue.release(lock);
+
+	}
+
+	void DBus::Member::Queue::start() {
+
+		if(dispatch.mode != Dispatch::Serial) {
+			return;
+		}
+
+		// The thread keeps the queue alive, it finishes after stop().
+		std::thread thread{[this,queue=shared_from_this()](){
+
+			Logger::String{"Serial dispatch thread started"}.trace(name.c_str());
+
+			unique_lock<mutex> lock(guard);
+			while(enabled) {
+
+				if(held || messages.empty()) {
+					condition.wait(lock);
+					continue;
+				}
+
+				DBusMessage *message = messages.front();
+				messages.pop_front();
+				condition.notify_all();
+
+				lock.unlock();
+				call(message);
+				lock.lock();
+
+			}
+
+			Logger::String{"Serial dispatch thread stopped"}.trace(name.c_str());
+
+		}};
+
+		thread.detach();
+
+	}
+
+	void DBus::Member::Queue::call(DBusMessage *message) noexcept {
+
+		try {
+
+			Message msg(message);
+			callback(msg);
+
+		} catch(const std::exception &e) {
+
+			Logger::String{e.what()}.error(name.c_str());
+
+		} catch(...) {
+
+			Logger::String{"Unexpected error"}.error(name.c_str());
+
+		}
+
+		dbus_message_unref(message);
+
+	}
+
+	void DBus::Member::Queue::run() {
+
+		unique_lock<mutex> lock(guard);
+		while(enabled && !held && !messages.empty()) {
+
+			DBusMessage *message = messages.front();
+			messages.pop_front();
+			condition.notify_all();
+
+			lock.unlock();
+			call(message);
+			lock.lock();
+
+		}
+
+		running = false;
+
+	}
+
+	bool DBus::Member::Queue::coalesce(DBusMessage *message) {
+
+		switch(dispatch.coalesce) {
+		case Dispatch::None:
+			break;
+
+		case Dispatch::Latest:
+			for(DBusMessage *pending : messages) {
+				dbus_message_unref(pending);
+			}
+			messages.clear();
+			condition.notify_all();
+			break;
+
+		case Dispatch::Merge:
+			{
+				std::string key;
+				if(!mergeable(message,key)) {
+					break;
+				}
+
+				for(DBusMessage * &pending : messages) {
+					std::string k;
+					if(mergeable(pending,k) && k == key) {
+						DBusMessage *merged = merge(pending,message);
+						dbus_message_unref(pending);
+						pending = merged;
+						return true;
+					}
+				}
+			}
+			break;
+
+		}
+
+		return false;
+
+	}
+
+	void DBus::Member::Queue::release(std::unique_lock<std::mutex> &lock) {
+
+		if(!enabled || held) {
+			return;
+		}
+
+		switch(dispatch.mode) {
+		case Dispatch::Inline:
+			// Called from the timer, deliver on the main loop.
+			while(enabled && !held && !messages.empty()) {
+
+				DBusMessage *message = messages.front();
+				messages.pop_front();
+				condition.notify_all();
+
+				lock.unlock();
+				call(message);
+				lock.lock();
+
+			}
+			break;
+
+		case Dispatch::Pool:
+			// Only one worker at a time, keeps the signals in order.
+			if(!running && !messages.empty()) {
+				running = true;
+				ThreadPool::getInstance().push(name.c_str(),[queue=shared_from_this()](){
+					queue->run();
+				});
+			}
+			break;
+
+		case Dispatch::Serial:
+			condition.notify_all();
+			break;
+
+		}
+
+	}
+
+	void DBus::Member::Queue::push(DBusMessage *message) {
+
+		unique_lock<mutex> lock(guard);
+
+		if(!enabled) {
+			if(reject) {
+				lock.unlock();
+				reject(message,DBUS_ERROR_FAILED,"Method is no longer available");
+			}
+			return;
+		}
+
+		if(!coalesce(message)) {
+
+			if(reject && messages.size() >= dispatch.limit) {
+				// Waiting would block the dispatch of the connection, refuse the call.
+				lock.unlock();
+				Logger::String{"Method call queue is full, rejecting the call"}.warning(name.c_str());
+				reject(message,DBUS_ERROR_LIMITS_EXCEEDED,"Too many pending calls");
+				return;
+			}
+
+			while(messages.size() >= dispatch.limit) {
+
+				if(held || dispatch.mode == Dispatch::Inline) {
+					// Only the timer, running on the main loop, can release the queue; cant wait for it.
+					Logger::String{"Signal queue is full, dropping the oldest signal"}.warning(name.c_str());
+					dbus_message_unref(messages.front());
+					messages.pop_front();
+					break;
+				}
+
+				Logger::String{"Signal queue is full, waiting for the handler"}.warning(name.c_str());
+
+				if(dispatching) {
+
+					// Dedicated d-bus thread, check for stop while waiting.
+					condition.wait_for(lock,std::chrono::milliseconds(100));
+					if(!*dispatching) {
+						Logger::String{"D-Bus thread is stopping, dropping the signal"}.warning(name.c_str());
+						return;
+					}
+
+				} else {
+
+					condition.wait(lock);
+
+				}
+
+				if(!enabled) {
+					return;
+				}
+
+			}
+
+			dbus_message_ref(message);
+			messages.push_back(message);
+
+		}
+
+		if(dispatch.window) {
+
+			// Hold the signals until the end of the time window.
+			if(!held) {
+				held = true;
+				timer.reset(dispatch.window);
+				timer.enable();
+			}
+			return;
+
+		}
+
+		release(lock);
+
+	}
+
+	void DBus::Member::Queue::bind(const std::atomic<bool> *enabled) noexcept {
+		dispatching = enabled;
+	}
+
+	void DBus::Member::Queue::stop() noexcept {
+
+		std::deque<DBusMessage *> pending;
+
+		{
+			lock_guard<mutex> lock(guard);
+
+			enabled = false;
+			timer.disable();
+
+			pending.swap(messages);
+
+			condition.notify_all();
+		}
+
+		for(DBusMessage *message : pending) {
+			if(reject) {
+				reject(message,DBUS_ERROR_FAILED,"Method is no longer available");
+			}
+			dbus_message_unref(message);
+		}
+
+	}
+
+ }
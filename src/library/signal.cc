@@ -51,6 +51,44 @@
 
 	}
 
+	DBus::Signal::Signal(const SignalTemplate &tmpl) : message{dbus_message_copy(tmpl.dbus_message())} {
+
+		if(!message) {
+			throw runtime_error("Can't create D-Bus signal from template");
+		}
+
+		dbus_message_iter_init_append(message, &iter);
+
+	}
+
+	DBus::SignalTemplate::SignalTemplate(const char *iface, const char *member, const char *path) {
+
+		DBusError err;
+		dbus_error_init(&err);
+
+		if(!(dbus_validate_interface(iface,&err) && dbus_validate_member(member,&err) && dbus_validate_path(path,&err))) {
+			string text{err.message ? err.message : "Invalid D-Bus name"};
+			dbus_error_free(&err);
+			throw system_error(EINVAL,system_category(),text);
+		}
+
+		message = dbus_message_new_signal(path,iface,member);
+		if(!message) {
+			throw runtime_error("Can't create D-Bus signal template");
+		}
+
+	}
+
+	DBus::SignalTemplate::~SignalTemplate() {
+		dbus_message_unref(message);
+	}
+
+	bool DBus::SignalTemplate::matches(const char *iface, const char *member, const char *path) const noexcept {
+		return	strcmp(iface,dbus_message_get_interface(message)) == 0
+				&& strcmp(member,dbus_message_get_member(message)) == 0
+				&& strcmp(path,dbus_message_get_path(message)) == 0;
+	}
+
 	DBus::Signal::~Signal() {
 
 		dbus_message_unref(message);
@@ -58,15 +96,15 @@
 	}
 
 	void DBus::Signal::system() {
-		SystemBus{}.signal(*this);
+		SystemBus::getInstance()->signal(*this);
 	}
 
 	void DBus::Signal::session() {
-		SessionBus{}.signal(*this);
+		SessionBus::getInstance()->signal(*this);
 	}
 
 	void DBus::Signal::starter() {
-		StarterBus{}.signal(*this);
+		StarterBus::getInstance()->signal(*this);
 	}
 
 	void DBus::Signal::user(uid_t uid, const char *sid) {
@@ -77,6 +115,34 @@
 		connection.signal(*this);
 	}
 
+	bool DBus::Signal::enqueue(Abstract::DBus::Connection &connection) {
+		return connection.enqueue(*this);
+	}
+
+	DBus::SignalBatch::~SignalBatch() {
+		clear();
+	}
+
+	DBus::SignalBatch & DBus::SignalBatch::push_back(const Signal &signal) {
+		messages.push_back(dbus_message_ref(signal.dbus_message()));
+		return *this;
+	}
+
+	void DBus::SignalBatch::clear() noexcept {
+		for(DBusMessage *message : messages) {
+			dbus_message_unref(message);
+		}
+		messages.clear();
+	}
+
+	void DBus::SignalBatch::emit(Abstract::DBus::Connection &connection) const {
+		connection.signal(*this);
+	}
+
+	bool DBus::SignalBatch::enqueue(Abstract::DBus::Connection &connection) const {
+		return connection.enqueue(*this);
+	}
+
 	DBus::Signal & DBus::Signal::push_back(const char *value) {
 		if(!dbus_message_iter_append_basic(&iter,DBUS_TYPE_STRING,&value)) {
 			throw runtime_error("Can't add value to d-bus iterator");
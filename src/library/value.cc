@@ -25,6 +25,9 @@
  #include <cstring>
  #include <string>
  #include <iostream>
+ #include <memory>
+ #include <vector>
+ #include <algorithm>
 
  using namespace std;
 
@@ -41,30 +44,194 @@
 
  namespace Udjat {
 
- 	DBus::Value::Value(const Value *src) {
+	/// @brief Bump allocator for the strings decoded from one message.
+	/// @details Not thread safe, a message is decoded by a single thread.
+	class DBus::Value::Arena {
+	private:
 
- 		type = src->type;
+		/// @brief Memory blocks.
+		std::vector<std::unique_ptr<char[]>> blocks;
 
- 		if(type == DBUS_TYPE_STRING) {
-			memset(&value,0,sizeof(value));
-			value.str = strdup(src->value.str);
- 		} else {
-			value = src->value;
- 		}
+		/// @brief Free space on the current block.
+		char *ptr = nullptr;
+		size_t available = 0;
+
+		static constexpr size_t BlockSize = 1024;
+
+	public:
+		Arena() {
+			blocks.reserve(4);
+		}
+
+		char * strdup(const char *str) {
+
+			size_t length = strlen(str)+1;
+
+			if(length > (BlockSize/4)) {
+				// Large string, use a dedicated block and keep the current one.
+				blocks.emplace_back(new char[length]);
+				return (char *) memcpy(blocks.back().get(),str,length);
+			}
+
+			if(length > available) {
+				blocks.emplace_back(new char[BlockSize]);
+				ptr = blocks.back().get();
+				available = BlockSize;
+			}
+
+			char *rc = (char *) memcpy(ptr,str,length);
+			ptr += length;
+			available -= length;
+			return rc;
+
+		}
+
+	};
+
+	/// @brief Check for string types.
+	static inline bool is_string(int type) noexcept {
+		return type == DBUS_TYPE_STRING || type == DBUS_TYPE_OBJECT_PATH || type == DBUS_TYPE_SIGNATURE;
+	}
+
+	/// @brief Get the signature of a basic type from a static table.
+	/// @return Signature, nullptr if the type is not basic.
+	static const char * basic_signature(int type) noexcept {
+
+		static const char basic[] = "y\0b\0n\0q\0i\0u\0x\0t\0d\0s\0o\0g\0h\0";
+
+		for(const char *ptr = basic; *ptr; ptr += 2) {
+			if(*ptr == (char) type) {
+				return ptr;
+			}
+		}
+
+		return nullptr;
+	}
+
+	/// @brief Get the signature of the current iter argument.
+	/// @return Signature from a static table for basic types, arena copy for containers.
+	static const char * signature_of(DBusMessageIter *iter, std::shared_ptr<DBus::Value::Arena> &arena) {
+
+		const char *rc = basic_signature(dbus_message_iter_get_arg_type(iter));
+		if(rc) {
+			return rc;
+		}
+
+		char *signature = dbus_message_iter_get_signature(iter);
+		if(!signature) {
+			throw runtime_error("Can't get d-bus argument signature");
+		}
+
+		if(!arena) {
+			arena = make_shared<DBus::Value::Arena>();
+		}
+
+		rc = arena->strdup(signature);
+		dbus_free(signature);
+		return rc;
 
 	}
 
-	DBus::Value::Value(const Value &src) {
+	/// @brief Get the size of a fixed type array element.
+	/// @return Element size, 0 if the type can't be handled as a fixed array.
+	static size_t fixed_size(int type) noexcept {
+
+		switch(type) {
+		case DBUS_TYPE_BYTE:
+			return 1;
+
+		case DBUS_TYPE_INT16:
+		case DBUS_TYPE_UINT16:
+			return 2;
+
+		case DBUS_TYPE_BOOLEAN:
+		case DBUS_TYPE_INT32:
+		case DBUS_TYPE_UINT32:
+			return 4;
 
- 		type = src.type;
+		case DBUS_TYPE_INT64:
+		case DBUS_TYPE_UINT64:
+		case DBUS_TYPE_DOUBLE:
+			return 8;
+
+		}
 
- 		if(type == DBUS_TYPE_STRING) {
-			memset(&value,0,sizeof(value));
-			value.str = strdup(src.value.str);
- 		} else {
+		return 0;
+	}
+
+ 	DBus::Value::Value(const Value *src) : Value(*src) {
+	}
+
+	DBus::Value::Value(const Value &src) : Value() {
+		*this = src;
+		key = src.key;
+	}
+
+	DBus::Value::Value(Value &&src) noexcept : Value() {
+		*this = std::move(src);
+		key = src.key;
+	}
+
+	DBus::Value & DBus::Value::operator=(const Value &src) {
+
+		if(&src == this) {
+			return *this;
+		}
+
+		reset();
+
+		type = src.type;
+		arena = src.arena;
+		signature = src.signature;
+
+		if(is_string(type) && src.storage != Shared) {
+			assign(src.value.str);
+		} else {
+			storage = src.storage;
 			value = src.value;
- 		}
+		}
+
+		// The keys are on the arena, shared with the source.
+		children = src.children;
+		index = src.index;
 
+		fixed.type = src.fixed.type;
+		fixed.data = src.fixed.data;
+
+		return *this;
+	}
+
+	DBus::Value & DBus::Value::operator=(Value &&src) noexcept {
+
+		if(&src == this) {
+			return *this;
+		}
+
+		reset();
+
+		type = src.type;
+		storage = src.storage;
+		value = src.value;
+		arena = std::move(src.arena);
+		signature = src.signature;
+		children = std::move(src.children);
+		index = std::move(src.index);
+		fixed.type = src.fixed.type;
+		fixed.data = std::move(src.fixed.data);
+
+		if(storage == Inline) {
+			memcpy(buffer,src.buffer,sizeof(buffer));
+			value.str = buffer;
+		}
+
+		// The source is now empty, don't release the moved string.
+		src.type = DBUS_TYPE_INVALID;
+		src.storage = Owned;
+		src.signature = nullptr;
+		src.fixed.type = DBUS_TYPE_INVALID;
+		memset(&src.value,0,sizeof(src.value));
+
+		return *this;
 	}
 
 	DBus::Value::Value() {
@@ -72,9 +239,28 @@
 		memset(&value,0,sizeof(value));
 	}
 
+	void DBus::Value::assign(const char *str) {
+
+		if(!str) {
+			storage = Owned;
+			value.str = nullptr;
+			return;
+		}
+
+		size_t length = strlen(str)+1;
+
+		if(length <= sizeof(buffer)) {
+			storage = Inline;
+			value.str = (char *) memcpy(buffer,str,length);
+		} else {
+			storage = Owned;
+			value.str = strdup(str);
+		}
+
+	}
+
 	DBus::Value::Value(Message &message) : Value() {
-		set(message.getIter());
-		message.next();
+		message.pop(*this);
 	}
 
 	DBus::Value::Value(int type, const char *str) : DBus::Value::Value() {
@@ -90,7 +276,7 @@
 				break;
 
 			case DBUS_TYPE_BOOLEAN:
-				value.bool_val = (std::stoi(str) != 0);
+				value.bool_val = (toupper(str[0]) == 'T' || std::atoi(str) != 0);
 				break;
 
 			case DBUS_TYPE_INT16:
@@ -122,7 +308,9 @@
 				break;
 
 			case DBUS_TYPE_STRING:
-				value.str = strdup(str);
+			case DBUS_TYPE_OBJECT_PATH:
+			case DBUS_TYPE_SIGNATURE:
+				assign(str);
 #ifdef DEBUG
 				cout << "value(" << ((char) this->type) << ")='" << value.str << "' (" << ((void *) value.str) << endl;
 #endif // DEBUG
@@ -146,70 +334,151 @@
 
 	Udjat::Value & DBus::Value::append(const Type UDJAT_UNUSED(unused)) {
 
-		if(type != DBUS_TYPE_ARRAY) {
+		if(type != DBUS_TYPE_ARRAY || fixed.type != DBUS_TYPE_INVALID) {
 			reset();
 			type = DBUS_TYPE_ARRAY;
 		}
 
-		Value * rc = new Value();
-		children[std::to_string((int) children.size()).c_str()] = rc;
-		return *rc;
+		return emplace_back();
 
 	}
 
+	DBus::Value & DBus::Value::emplace_back() {
+		return children.emplace_back();
+	}
+
 	Udjat::Value & DBus::Value::set(const Udjat::Value UDJAT_UNUSED(&value)) {
 		throw system_error(ENOTSUP,system_category(),"Cant set value");
 	}
 
 	Udjat::Value & DBus::Value::operator[](const char *name) {
 
-		if(type != DBUS_TYPE_DICT_ENTRY) {
+		if(type == DBUS_TYPE_VARIANT && !empty()) {
+			return children.front()[name];
+		}
+
+		if(type != DBUS_TYPE_DICT_ENTRY && !(type == DBUS_TYPE_ARRAY && signature && *signature == DBUS_DICT_ENTRY_BEGIN_CHAR)) {
 			reset();
 			type = DBUS_TYPE_DICT_ENTRY;
 		}
 
-		auto search = children.find(name);
-		if(search != children.end()) {
-			return *search->second;
+		return child(name);
+
+	}
+
+	DBus::Value & DBus::Value::child(const char *name) {
+
+		auto it = std::lower_bound(index.begin(),index.end(),name,[this](uint32_t pos, const char *name){
+			return strcmp(children[pos].key,name) < 0;
+		});
+
+		if(it != index.end() && strcmp(children[*it].key,name) == 0) {
+			return children[*it];
+		}
+
+		// The key is kept on the arena, with the decoded strings.
+		if(!arena) {
+			arena = make_shared<Arena>();
+		}
+
+		index.insert(it,(uint32_t) children.size());
+		Value &value = children.emplace_back();
+		value.key = arena->strdup(name);
+		return value;
+
+	}
+
+	const DBus::Value * DBus::Value::search(const char *name) const noexcept {
+
+		auto it = std::lower_bound(index.begin(),index.end(),name,[this](uint32_t pos, const char *name){
+			return strcmp(children[pos].key,name) < 0;
+		});
+
+		if(it != index.end() && strcmp(children[*it].key,name) == 0) {
+			return &children[*it];
+		}
+
+		return nullptr;
+
+	}
+
+	const DBus::Value * DBus::Value::find(const char *name) const noexcept {
+
+		if(type == DBUS_TYPE_VARIANT && !empty()) {
+			return children.front().search(name);
 		}
 
-		Value * rc = new DBus::Value();
+		return search(name);
+
+	}
+
+	const DBus::Value & DBus::Value::content() const {
 
-		children[name] = rc;
+		const Value *value = this;
+		while(value->type == DBUS_TYPE_VARIANT) {
+			if(value->empty()) {
+				throw runtime_error("Empty DBUS_TYPE_VARIANT value");
+			}
+			value = &value->children.front();
+		}
 
-		return *rc;
+		return *value;
 
 	}
 
 	Udjat::Value & DBus::Value::reset(const Udjat::Value::Type UDJAT_UNUSED(unused)) {
 
-		if(type == DBUS_TYPE_STRING && value.str) {
+		if(is_string(type) && value.str && storage == Owned) {
 			free(value.str);
 			value.str = NULL;
 		}
 
+		storage = Owned;
+
+		arena.reset();
+		signature = nullptr;
+
 		type = DBUS_TYPE_INVALID;
 		memset(&value,0,sizeof(value));
 
-		// cleanup children.
-		for(auto child : children) {
-			delete child.second;
-		}
-
+		// The key is set by the parent, keep it.
 		children.clear();
+		index.clear();
+
+		fixed.type = DBUS_TYPE_INVALID;
+		fixed.data.clear();
 
 		return *this;
 	}
 
+	void DBus::Value::set(int type, const void *data, size_t length) {
+		reset(Value::Type::Undefined);
+		this->type = DBUS_TYPE_ARRAY;
+		fixed.type = type;
+		fixed.data.assign((const uint8_t *) data, ((const uint8_t *) data) + length);
+	}
+
+	const void * DBus::Value::get(int type, size_t &length) const noexcept {
+
+		if(this->type != DBUS_TYPE_ARRAY || fixed.type != type) {
+			length = 0;
+			return nullptr;
+		}
+
+		length = fixed.data.size();
+		return fixed.data.data();
+
+	}
+
 	Udjat::Value & DBus::Value::set(const TimeStamp value) {
 
 		reset(Value::Type::Undefined);
 		this->type = DBUS_TYPE_STRING;
 
 		if(value) {
-			this->value.str = strdup(value.to_string("%Y-%m-%d %H:%M:%S").c_str());
+			assign(value.to_string("%Y-%m-%d %H:%M:%S").c_str());
 		} else {
-			this->value.str = strdup("");
+			assign("");
 		}
 
 		return *this;
@@ -218,7 +487,7 @@
 	Udjat::Value & DBus::Value::set(const char *value, const Type UDJAT_UNUSED(type)) {
 		reset(Value::Type::Undefined);
 		this->type = DBUS_TYPE_STRING;
-		this->value.str = strdup(value);
+		assign(value);
 		return *this;
 	}
 
@@ -289,14 +558,14 @@
 
 		string str{"("};
 
-		for(auto child : this->children) {
+		for(const Value &child : children) {
 
-			if(child.second->noSignature()) {
+			if(child.noSignature()) {
 				continue;
 			}
 
 			char v[2];
-			v[0] = (char) child.second->type;
+			v[0] = (char) child.type;
 			v[1] = 0;
 			str += v;
 		}
@@ -307,6 +576,11 @@
 	}
 
 	bool DBus::Value::set(DBusMessageIter *iter) {
+		std::shared_ptr<Arena> arena;
+		return set(iter,arena);
+	}
+
+	bool DBus::Value::set(DBusMessageIter *iter, std::shared_ptr<Arena> &arena, bool borrow) {
 
 		reset(Value::Type::Undefined);
 
@@ -317,26 +591,142 @@
 			return false;
 
 		case DBUS_TYPE_ARRAY:
-			cerr << "d-bus\tUnsupported DBUS_TYPE_ARRAY value" << endl;
-			reset(Value::Type::Undefined);
-			return false;
+			{
+				int element = dbus_message_iter_get_element_type(iter);
+				size_t szElement = fixed_size(element);
 
-		case DBUS_TYPE_DICT_ENTRY:
-			cerr << "d-bus\tUnsupported DBUS_TYPE_DICT_ENTRY value" << endl;
-			reset(Value::Type::Undefined);
-			return false;
+				DBusMessageIter subIter;
+				dbus_message_iter_recurse(iter,&subIter);
+
+				if(szElement) {
+
+					// Fixed type array, copy the elements in one block.
+					const void *ptr = nullptr;
+					int length = 0;
+					if(dbus_message_iter_get_arg_type(&subIter) != DBUS_TYPE_INVALID) {
+						dbus_message_iter_get_fixed_array(&subIter,&ptr,&length);
+					}
+
+					fixed.type = element;
+					if(length > 0) {
+						fixed.data.assign((const uint8_t *) ptr, ((const uint8_t *) ptr) + (length * szElement));
+					}
+
+					break;
+				}
+
+				// Element signature, skip the array type.
+				signature = basic_signature(element);
+				if(!signature) {
+					signature = signature_of(iter,arena) + 1;
+				}
+				this->arena = arena;
+
+				// Allocate the children once; the loop below uses each child only until the next insertion.
+				int count = dbus_message_iter_get_element_count(iter);
+				if(count > 0) {
+					children.reserve(count);
+				}
+
+				if(element == DBUS_TYPE_DICT_ENTRY) {
+
+					// Dictionary, the children are indexed by key.
+					if(count > 0) {
+						index.reserve(count);
+					}
+
+					string key;
+					while(dbus_message_iter_get_arg_type(&subIter) == DBUS_TYPE_DICT_ENTRY) {
+
+						DBusMessageIter entry;
+						dbus_message_iter_recurse(&subIter,&entry);
+
+						const char *name;
+						if(is_string(dbus_message_iter_get_arg_type(&entry))) {
+
+							// String key, copied from the message to the arena by child().
+							DBusBasicValue basic;
+							dbus_message_iter_get_basic(&entry,&basic);
+							name = basic.str;
+
+						} else {
+
+							Value decoded;
+							decoded.set(&entry,arena,true);
+							decoded.get(key);
+							name = key.c_str();
+
+						}
+
+						dbus_message_iter_next(&entry);
+						child(name).set(&entry,arena,borrow);
+
+						dbus_message_iter_next(&subIter);
+					}
+
+				} else {
+
+					while(dbus_message_iter_get_arg_type(&subIter) != DBUS_TYPE_INVALID) {
+						emplace_back().set(&subIter,arena,borrow);
+						dbus_message_iter_next(&subIter);
+					}
+
+				}
+
+			}
+			break;
+
+		case DBUS_TYPE_STRUCT:
+			{
+				DBusMessageIter subIter;
+				dbus_message_iter_recurse(iter,&subIter);
+
+				while(dbus_message_iter_get_arg_type(&subIter) != DBUS_TYPE_INVALID) {
+					emplace_back().set(&subIter,arena,borrow);
+					dbus_message_iter_next(&subIter);
+				}
+
+			}
+			break;
 
 		case DBUS_TYPE_VARIANT:
-			cerr << "d-bus\tUnsupported DBUS_TYPE_VARIANT value" << endl;
+			{
+				DBusMessageIter subIter;
+				dbus_message_iter_recurse(iter,&subIter);
+
+				signature = signature_of(&subIter,arena);
+				this->arena = arena;
+
+				children.reserve(1);
+				emplace_back().set(&subIter,arena,borrow);
+
+			}
+			break;
+
+		case DBUS_TYPE_DICT_ENTRY:
+			cerr << "d-bus\tUnexpected DBUS_TYPE_DICT_ENTRY value" << endl;
 			reset(Value::Type::Undefined);
 			return false;
 
 		default:
 			dbus_message_iter_get_basic(iter,&value);
-			if(type == DBUS_TYPE_STRING) {
-				// String, copy the value.
-				char * dup = strdup(value.str);
-				value.str = dup;
+			if(is_string(type)) {
+
+				if(borrow) {
+					// Keep the pointer to the message buffer.
+					storage = Borrowed;
+				} else if(strlen(value.str) < sizeof(buffer)) {
+					assign(value.str);
+				} else {
+					// Long string, copy the value to the message arena.
+					if(!arena) {
+						arena = make_shared<Arena>();
+					}
+					value.str = arena->strdup(value.str);
+					storage = Shared;
+					this->arena = arena;
+				}
+
 			}
 
 		}
@@ -351,40 +741,125 @@
 		case DBUS_TYPE_INVALID:
 			return;
 
-		case DBUS_TYPE_ARRAY:
+		case DBUS_TYPE_VARIANT:
+			{
+				DBusMessageIter subIter;
+
+				if(!signature || empty()) {
+					throw runtime_error("Can't add empty variant to d-bus iterator");
+				}
+
+				if(!dbus_message_iter_open_container(iter, DBUS_TYPE_VARIANT, signature, &subIter)) {
+					throw runtime_error("Can't open d-bus variant");
+				}
+
+				children.front().get(&subIter);
+				dbus_message_iter_close_container(iter, &subIter);
+
+			}
+			return;
+
+		case DBUS_TYPE_STRUCT:
 			{
 				DBusMessageIter subIter;
 
-				if(!this->children.empty()) {
+				if(!dbus_message_iter_open_container(iter, DBUS_TYPE_STRUCT, NULL, &subIter)) {
+					throw runtime_error("Can't open d-bus struct");
+				}
+
+				for(size_t ix = 0; ix < size(); ix++) {
+					children[ix].get(&subIter);
+				}
+
+				dbus_message_iter_close_container(iter, &subIter);
+
+			}
+			return;
+
+		case DBUS_TYPE_ARRAY:
+			if(signature) {
+
+				// Decoded array, use the original element signature.
+				DBusMessageIter subIter;
+
+				if(!dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY, signature, &subIter)) {
+					throw runtime_error("Can't open d-bus array");
+				}
 
-					string signature = this->children.begin()->second->getArraySignature();
+				for(size_t ix = 0; ix < size(); ix++) {
+
+					if(*signature != DBUS_DICT_ENTRY_BEGIN_CHAR) {
+						children[ix].get(&subIter);
+						continue;
+					}
+
+					DBusMessageIter entry;
+					if(!dbus_message_iter_open_container(&subIter, DBUS_TYPE_DICT_ENTRY, NULL, &entry)) {
+						throw runtime_error("Can't open d-bus dictionary entry");
+					}
+
+					Value{signature[1],children[ix].key}.get(&entry);
+					children[ix].get(&entry);
+
+					dbus_message_iter_close_container(&subIter, &entry);
+
+				}
+
+				dbus_message_iter_close_container(iter, &subIter);
+
+			} else if(fixed.type != DBUS_TYPE_INVALID) {
+
+				// Fixed type array, add the elements in one call.
+				DBusMessageIter subIter;
+				const char signature[] = { (char) fixed.type, 0 };
+
+				if(!dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY, signature, &subIter)) {
+					throw runtime_error("Can't open d-bus array");
+				}
+
+				const void *ptr = fixed.data.data();
+				if(!dbus_message_iter_append_fixed_array(&subIter,fixed.type,&ptr,(int) (fixed.data.size() / fixed_size(fixed.type)))) {
+					dbus_message_iter_abandon_container(iter,&subIter);
+					throw runtime_error("Can't add fixed array to d-bus iterator");
+				}
+
+				dbus_message_iter_close_container(iter, &subIter);
+
+			} else {
+				DBusMessageIter subIter;
+
+				if(!empty()) {
+
+					string signature = children.front().getArraySignature();
 
 					if(dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY, signature.c_str(), &subIter)) {
 
-						for(auto row : this->children) {
+						for(const Value &row : children) {
 
 							DBusMessageIter aIter;
 
 							if(dbus_message_iter_open_container(&subIter, DBUS_TYPE_STRUCT, NULL, &aIter)) {
 
 								const char *ptr = signature.c_str() + 1;
-								for(auto child : row.second->children) {
+								for(size_t ix = 0; ix < row.size(); ix++) {
+
+									const Value &child = row.children[ix];
 
-									if(child.second->noSignature() || !*ptr) {
+									if(child.noSignature() || !*ptr) {
 										continue;
 									}
 
-									if(*ptr != ((char) child.second->type)) {
+									if(*ptr != ((char) child.type)) {
 
 										cerr << "DBus\tUnexpected signature. Got '"
-												<< ((char) child.second->type)
+												<< ((char) child.type)
 												<< "' while expecting for '"
 												<< *ptr << "'" << endl;
 										continue;
 									}
 
 									ptr++;
-									child.second->get(&aIter);
+									child.get(&aIter);
 
 								}
 
@@ -405,8 +880,8 @@
 				DBusMessageIter subIter;
 				if(dbus_message_iter_open_container(iter, DBUS_TYPE_STRUCT, NULL, &subIter)) {
 
-					for(auto child : this->children) {
-						child.second->get(&subIter);
+					for(size_t ix = 0; ix < size(); ix++) {
+						children[ix].get(&subIter);
 					}
 
 					dbus_message_iter_close_container(iter, &subIter);
@@ -416,7 +891,7 @@
 			return;
 		}
 
-		if(!children.empty()) {
+		if(!empty()) {
 			return;
 		}
 
@@ -432,12 +907,162 @@
 
 	}
 
+	/// @brief Set generic value from a basic d-bus value.
+	static void set_basic(Udjat::Value &value, int type, const DBusBasicValue &basic) {
+
+		switch(type) {
+		case DBUS_TYPE_BOOLEAN:
+			value.set((bool) basic.bool_val);
+			break;
+
+		case DBUS_TYPE_BYTE:
+			value.set((unsigned short) basic.byt);
+			break;
+
+		case DBUS_TYPE_INT16:
+			value.set((short) basic.i16);
+			break;
+
+		case DBUS_TYPE_UINT16:
+			value.set((unsigned short) basic.u16);
+			break;
+
+		case DBUS_TYPE_INT32:
+		case DBUS_TYPE_UNIX_FD:
+			value.set((int) basic.i32);
+			break;
+
+		case DBUS_TYPE_UINT32:
+			value.set((unsigned int) basic.u32);
+			break;
+
+		case DBUS_TYPE_INT64:
+			value.set((long) basic.i64);
+			break;
+
+		case DBUS_TYPE_UINT64:
+			value.set((unsigned long) basic.u64);
+			break;
+
+		case DBUS_TYPE_DOUBLE:
+			value.set((double) basic.dbl);
+			break;
+
+		case DBUS_TYPE_STRING:
+		case DBUS_TYPE_OBJECT_PATH:
+		case DBUS_TYPE_SIGNATURE:
+			value.set(basic.str ? basic.str : "",Udjat::Value::String);
+			break;
+
+		default:
+			value.reset(Udjat::Value::Undefined);
+
+		}
+
+	}
+
+	const Udjat::Value & DBus::Value::get(Udjat::Value &value) const {
+
+		const Value &src = content();
+
+		if(src.type == DBUS_TYPE_ARRAY && src.fixed.type != DBUS_TYPE_INVALID) {
+
+			// Fixed type array, copy the elements from the contiguous storage.
+			value.reset(Udjat::Value::Array);
+
+			size_t length = fixed_size(src.fixed.type);
+			for(size_t offset = 0; length && offset + length <= src.fixed.data.size(); offset += length) {
+				DBusBasicValue element;
+				memset(&element,0,sizeof(element));
+				memcpy(&element,src.fixed.data.data()+offset,length);
+				set_basic(value.append(Udjat::Value::Undefined),src.fixed.type,element);
+			}
+
+			return value;
+		}
+
+		bool named = (src.type == DBUS_TYPE_DICT_ENTRY || (src.type == DBUS_TYPE_ARRAY && src.signature && *src.signature == DBUS_DICT_ENTRY_BEGIN_CHAR));
+
+		if(named) {
+
+			value.reset(Udjat::Value::Object);
+			for(size_t ix = 0; ix < src.size(); ix++) {
+				src.children[ix].get(value[src.children[ix].key]);
+			}
+
+		} else if(src.type == DBUS_TYPE_ARRAY || src.type == DBUS_TYPE_STRUCT) {
+
+			value.reset(Udjat::Value::Array);
+			for(size_t ix = 0; ix < src.size(); ix++) {
+				src.children[ix].get(value.append(Udjat::Value::Undefined));
+			}
+
+		} else {
+
+			set_basic(value,src.type,src.value);
+
+		}
+
+		return value;
+
+	}
+
+	void DBus::Value::variant(DBusMessageIter *iter) const {
+
+		if(type == DBUS_TYPE_VARIANT) {
+			get(iter);
+			return;
+		}
+
+		string array;
+		const char *signature = basic_signature(type);
+
+		if(!signature) {
+
+			if(type == DBUS_TYPE_ARRAY && this->signature) {
+				array = string{"a"} + this->signature;
+			} else if(type == DBUS_TYPE_ARRAY && fixed.type != DBUS_TYPE_INVALID) {
+				array = string{"a"} + (char) fixed.type;
+			} else {
+				throw runtime_error(string{"Can't wrap d-bus value of type '"} + (char) type + "' in a variant");
+			}
+
+			signature = array.c_str();
+		}
+
+		DBusMessageIter subIter;
+		if(!dbus_message_iter_open_container(iter, DBUS_TYPE_VARIANT, signature, &subIter)) {
+			throw runtime_error("Can't open d-bus variant");
+		}
+
+		try {
+
+			get(&subIter);
+
+		} catch(...) {
+
+			dbus_message_iter_abandon_container(iter,&subIter);
+			throw;
+
+		}
+
+		dbus_message_iter_close_container(iter, &subIter);
+
+	}
+
 	const Udjat::Value & DBus::Value::get(std::string &value) const {
 
+		if(type == DBUS_TYPE_VARIANT) {
+			content().get(value);
+			return *this;
+		}
+
 		switch(this->type) {
 		EXCEPTION_ON_UNSUPPORTED_OR_INVALID
 
 		case DBUS_TYPE_STRING:
+		case DBUS_TYPE_OBJECT_PATH:
+		case DBUS_TYPE_SIGNATURE:
 			value = this->value.str;
 			break;
 
@@ -445,6 +1070,38 @@
 			value = (this->value.bool_val ? "true" : "false");
 			break;
 
+		case DBUS_TYPE_BYTE:
+			value.assign(1,(char) this->value.byt);
+			break;
+
+		case DBUS_TYPE_INT16:
+			value = std::to_string(this->value.i16);
+			break;
+
+		case DBUS_TYPE_UINT16:
+			value = std::to_string(this->value.u16);
+			break;
+
+		case DBUS_TYPE_INT32:
+			value = std::to_string(this->value.i32);
+			break;
+
+		case DBUS_TYPE_UINT32:
+			value = std::to_string(this->value.u32);
+			break;
+
+		case DBUS_TYPE_INT64:
+			value = std::to_string(this->value.i64);
+			break;
+
+		case DBUS_TYPE_UINT64:
+			value = std::to_string(this->value.u64);
+			break;
+
+		case DBUS_TYPE_DOUBLE:
+			value = std::to_string(this->value.dbl);
+			break;
+
 		default:
 			throw runtime_error("Unable to convert dbus value to string");
 		}
@@ -455,6 +1112,11 @@
 
 	const Udjat::Value & DBus::Value::get(bool &value) const {
 
+		if(type == DBUS_TYPE_VARIANT) {
+			content().get(value);
+			return *this;
+		}
+
 		if(this->type == DBUS_TYPE_BOOLEAN) {
 			value = this->value.bool_val;
 
@@ -532,32 +1194,38 @@
 	}
 
 	const Udjat::Value & DBus::Value::get(unsigned short &value) const {
-		value = convert<unsigned short>(type,this->value);
+		const Value &v = content();
+		value = convert<unsigned short>(v.type,v.value);
 		return *this;
 	}
 
 	const Udjat::Value & DBus::Value::get(short &value) const {
-		value = convert<short>(type,this->value);
+		const Value &v = content();
+		value = convert<short>(v.type,v.value);
 		return *this;
 	}
 
 	const Udjat::Value & DBus::Value::get(int &value) const {
-		value = convert<int>(type,this->value);
+		const Value &v = content();
+		value = convert<int>(v.type,v.value);
 		return *this;
 	}
 
 	const Udjat::Value & DBus::Value::get(unsigned int &value) const {
-		value = convert<unsigned int>(type,this->value);
+		const Value &v = content();
+		value = convert<unsigned int>(v.type,v.value);
 		return *this;
 	}
 
 	const Udjat::Value & DBus::Value::get(long &value) const {
-		value = convert<long>(type,this->value);
+		const Value &v = content();
+		value = convert<long>(v.type,v.value);
 		return *this;
 	}
 
 	const Udjat::Value & DBus::Value::get(unsigned long &value) const {
-		value = convert<unsigned long>(type,this->value);
+		const Value &v = content();
+		value = convert<unsigned long>(v.type,v.value);
 		return *this;
 	}
 
@@ -566,12 +1234,14 @@
 	}
 
 	const Udjat::Value & DBus::Value::get(float &value) const {
-		value = convert<float>(type,this->value);
+		const Value &v = content();
+		value = convert<float>(v.type,v.value);
 		return *this;
 	}
 
 	const Udjat::Value & DBus::Value::get(double &value) const {
-		value = convert<double>(type,this->value);
+		const Value &v = content();
+		value = convert<double>(v.type,v.value);
 		return *this;
 	}
 
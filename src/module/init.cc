@@ -24,6 +24,7 @@
  #include <udjat/factory.h>
  #include <dbus/dbus-protocol.h>
  #include <udjat/alert/d-bus.h>
+ #include <udjat/agent/d-bus.h>
  #include <memory>
 
  using namespace std;
@@ -47,6 +48,10 @@
 			return make_shared<Udjat::DBus::Alert>(parent,node);
 		}
 
+		std::shared_ptr<Abstract::Agent> AgentFactory(const Abstract::Object UDJAT_UNUSED(&parent), const pugi::xml_node &node) const override {
+			return make_shared<Udjat::DBus::Agent>(node);
+		}
+
 	};
 
 	return new Module();
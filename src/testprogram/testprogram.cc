@@ -25,7 +25,8 @@
  #include <udjat/tools/logger.h>
  #include <udjat/tools/dbus/connection.h>
  #include <udjat/tools/dbus/message.h>
- #include <udjat/tools/threadpool.h>
+ #include <udjat/tools/dbus/exporter.h>
+ #include <memory>
 
  #if UDJAT_CHECK_VERSION(1,2,0)
 	#include <udjat/tools/factory.h>
@@ -74,6 +75,37 @@
 
  };
 
+ /// @brief Export the agents on the session bus, as 'br.eti.werneck.udjat' for the test scripts.
+ class TestApplication : public Udjat::Application {
+ private:
+	std::unique_ptr<DBus::Exporter> exporter;
+
+ public:
+	void root(std::shared_ptr<Abstract::Agent> agent) override {
+
+		exporter.reset();
+		Udjat::Application::root(agent);
+
+		if(agent) {
+
+			auto bus = Abstract::DBus::Connection::getInstance(DBUS_BUS_SESSION);
+
+			DBusError err;
+			dbus_error_init(&err);
+			dbus_bus_request_name(bus->connection(),"br.eti.werneck.udjat",DBUS_NAME_FLAG_DO_NOT_QUEUE,&err);
+			if(dbus_error_is_set(&err)) {
+				Logger::String{"Can't request 'br.eti.werneck.udjat': ",err.message}.warning("d-bus");
+				dbus_error_free(&err);
+			}
+
+			exporter = make_unique<DBus::Exporter>(bus,agent);
+
+		}
+
+	}
+
+ };
+
  int main(int argc, char **argv) {
 
 	Logger::verbosity(9);
@@ -87,10 +119,8 @@
 
 		cout << "Got signal hello" << endl;
 
-		// Cant remove member while running, then, enqueue cleanup.
-		ThreadPool::getInstance().push([&member,&bus](){
-			bus.remove(*member);
-		});
+		// One-shot subscription, the member is released after the dispatch.
+		bus.remove(*member);
 
 	});
 
@@ -131,7 +161,7 @@
 	udjat_module_init();
 	RandomFactory rfactory;
 
-	auto rc = Application{}.run(argc,argv,"./test.xml");
+	auto rc = TestApplication{}.run(argc,argv,"./test.xml");
 
 	debug("Application exits with rc=",rc);
 
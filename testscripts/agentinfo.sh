@@ -27,3 +27,13 @@ dbus-send \
 	br.eti.werneck.udjat.agent.info
 	
 
+
+# Agent properties, exported by an application using DBus::Exporter and owning the bus name.
+dbus-send \
+	--session \
+	--dest=br.eti.werneck.udjat \
+	--print-reply \
+	"/intvalue" \
+	org.freedesktop.DBus.Properties.GetAll \
+	string:br.eti.werneck.udjat.agent
+